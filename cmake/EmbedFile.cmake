@@ -0,0 +1,19 @@
+# Converts a binary file into a C++ header holding its bytes.
+# Usage: cmake -DINPUT=<file> -DOUTPUT=<header> -DNAME=<symbol> -P EmbedFile.cmake
+
+file(READ ${INPUT} HEX_CONTENT HEX)
+get_filename_component(INPUT_NAME ${INPUT} NAME)
+
+# Break the array into lines of 16 bytes to keep the header readable
+set(LINE_PATTERN "")
+foreach(INDEX RANGE 1 16)
+    set(LINE_PATTERN "${LINE_PATTERN}[0-9a-f][0-9a-f]")
+endforeach()
+string(REGEX REPLACE "(${LINE_PATTERN})" "\\1\n" HEX_CONTENT "${HEX_CONTENT}")
+string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," BYTES "${HEX_CONTENT}")
+
+file(WRITE ${OUTPUT}
+    "// Generated from ${INPUT_NAME}, do not edit.\n"
+    "#pragma once\n\n"
+    "const unsigned char ${NAME}[] = {\n${BYTES}\n};\n"
+    "const unsigned int ${NAME}_SIZE = sizeof(${NAME});\n")
@@ -0,0 +1,139 @@
+#include "audio.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace {
+
+constexpr double PI = 3.14159265358979323846;
+
+// Square wave blip with an exponential decay, sweeping from startFrequency
+// to endFrequency over its length
+Sound synthesiseSound(double startFrequency,
+                      double endFrequency,
+                      double lengthSeconds,
+                      double volume) {
+    Sound sound;
+    size_t sampleCount =
+        static_cast<size_t>(lengthSeconds * AUDIO_SAMPLE_RATE);
+    sound.samples.resize(sampleCount);
+
+    double phase = 0.0;
+    for (size_t i = 0; i < sampleCount; i++) {
+        double progress = static_cast<double>(i) / sampleCount;
+        double frequency =
+            startFrequency + (endFrequency - startFrequency) * progress;
+        phase += 2.0 * PI * frequency / AUDIO_SAMPLE_RATE;
+
+        double envelope = std::exp(-4.0 * progress);
+        double wave = std::sin(phase) >= 0.0 ? 1.0 : -1.0;
+        sound.samples[i] =
+            static_cast<int16_t>(wave * envelope * volume * INT16_MAX);
+    }
+
+    return sound;
+}
+
+void startVoice(AudioState& audioState, GameEvent event) {
+    const Sound* sound = &audioState.sounds[event];
+    if (sound->samples.empty()) {
+        return;
+    }
+
+    // Use a free voice, or steal the one closest to finishing when all of
+    // them are playing
+    Voice* voice = nullptr;
+    size_t leastRemaining = SIZE_MAX;
+    for (Voice& candidate : audioState.voices) {
+        if (!candidate.sound) {
+            voice = &candidate;
+            break;
+        }
+
+        size_t remaining = candidate.sound->samples.size() - candidate.position;
+        if (remaining < leastRemaining) {
+            leastRemaining = remaining;
+            voice = &candidate;
+        }
+    }
+
+    voice->sound = sound;
+    voice->position = 0;
+}
+
+// Runs on the SDL audio thread, must not lock or allocate
+void audioCallback(void* userdata, Uint8* stream, int length) {
+    AudioState& audioState = *static_cast<AudioState*>(userdata);
+    int16_t* output = reinterpret_cast<int16_t*>(stream);
+    int sampleCount = length / static_cast<int>(sizeof(int16_t));
+
+    GameEvent event;
+    while (audioState.eventQueue->pop(event)) {
+        startVoice(audioState, event);
+    }
+
+    for (int i = 0; i < sampleCount; i++) {
+        int32_t mixed = 0;
+        for (Voice& voice : audioState.voices) {
+            if (!voice.sound) {
+                continue;
+            }
+
+            mixed += voice.sound->samples[voice.position++];
+            if (voice.position >= voice.sound->samples.size()) {
+                voice.sound = nullptr;
+            }
+        }
+
+        output[i] = static_cast<int16_t>(
+            std::max<int32_t>(INT16_MIN, std::min<int32_t>(INT16_MAX, mixed)));
+    }
+}
+
+}  // namespace
+
+bool SDLInitialiseAudio(AudioState& audioState, GameEventQueue& eventQueue) {
+    audioState.eventQueue = &eventQueue;
+
+    audioState.sounds[EVENT_MOVE] = synthesiseSound(1200, 1200, 0.02, 0.15);
+    audioState.sounds[EVENT_ROTATE] = synthesiseSound(800, 1000, 0.03, 0.15);
+    audioState.sounds[EVENT_LOCK] = synthesiseSound(220, 160, 0.06, 0.25);
+    audioState.sounds[EVENT_LINE_CLEAR] = synthesiseSound(440, 880, 0.2, 0.25);
+
+    // Audio is started on demand so it does not slow down startup
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0) {
+        SDL_Log("Failed to initialise audio: %s", SDL_GetError());
+        return false;
+    }
+
+    SDL_AudioSpec desired;
+    SDL_memset(&desired, 0, sizeof(desired));
+    desired.freq = AUDIO_SAMPLE_RATE;
+    desired.format = AUDIO_S16SYS;
+    desired.channels = 1;
+    desired.samples = AUDIO_BUFFER_SAMPLES;
+    desired.callback = audioCallback;
+    desired.userdata = &audioState;
+
+    SDL_AudioSpec obtained;
+    audioState.device = SDL_OpenAudioDevice(NULL, 0, &desired, &obtained, 0);
+    if (audioState.device == 0) {
+        SDL_Log("Failed to open audio device: %s", SDL_GetError());
+        SDL_QuitSubSystem(SDL_INIT_AUDIO);
+        return false;
+    }
+
+    SDL_PauseAudioDevice(audioState.device, 0);
+    return true;
+}
+
+void SDLCloseAudio(AudioState& audioState) {
+    if (audioState.device == 0) {
+        return;
+    }
+
+    SDL_CloseAudioDevice(audioState.device);
+    SDL_QuitSubSystem(SDL_INIT_AUDIO);
+    audioState.device = 0;
+}
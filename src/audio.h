@@ -0,0 +1,37 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_audio.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "game.h"
+
+constexpr int AUDIO_SAMPLE_RATE = 48000;
+// 256 samples at 48 kHz is ~5 ms, the upper bound on event to sound latency
+constexpr int AUDIO_BUFFER_SAMPLES = 256;
+constexpr int AUDIO_MAX_VOICES = 8;
+
+struct Sound {
+    std::vector<int16_t> samples;
+};
+
+struct Voice {
+    const Sound* sound = nullptr;
+    size_t position = 0;
+};
+
+struct AudioState {
+    SDL_AudioDeviceID device = 0;
+    GameEventQueue* eventQueue = nullptr;
+
+    // Decoded once at startup, only read from the audio thread afterwards
+    Sound sounds[EVENT_COUNT];
+
+    // Owned by the audio thread
+    Voice voices[AUDIO_MAX_VOICES];
+};
+
+bool SDLInitialiseAudio(AudioState& audioState, GameEventQueue& eventQueue);
+void SDLCloseAudio(AudioState& audioState);
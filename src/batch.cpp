@@ -0,0 +1,377 @@
+#include "batch.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Block x positions covered by the shifted row tables, anything outside is
+// out of bounds for every shape anyway
+constexpr int MIN_TABLE_X_POS = -8;
+constexpr int TABLE_X_POS_COUNT = 24;
+
+struct ShapeLayout {
+    // Shape rows already shifted to column xPos, indexed [xPos - MIN][row]
+    uint16_t shiftedRows[TABLE_X_POS_COUNT][PART_SIZE];
+    int lowestX;
+    int highestX;
+    int highestY;
+};
+
+struct ShapeTables {
+    ShapeLayout layouts[7][4];
+};
+
+ShapeTables buildShapeTables() {
+    ShapeTables tables;
+
+    for (int blockIndex = 0; blockIndex < 7; blockIndex++) {
+        for (int rotationIndex = 0; rotationIndex < 4; rotationIndex++) {
+            unsigned long shape =
+                availableBlocks[blockIndex][rotationIndex].to_ulong();
+            ShapeLayout& layout = tables.layouts[blockIndex][rotationIndex];
+            layout.lowestX = PART_SIZE;
+            layout.highestX = -1;
+            layout.highestY = -1;
+
+            for (int y = 0; y < PART_SIZE; y++) {
+                unsigned int part = (shape >> (y * PART_SIZE)) & 0xF;
+                for (int x = 0; x < PART_SIZE; x++) {
+                    if (part & (1u << x)) {
+                        layout.lowestX = std::min(layout.lowestX, x);
+                        layout.highestX = std::max(layout.highestX, x);
+                        layout.highestY = y;
+                    }
+                }
+
+                for (int i = 0; i < TABLE_X_POS_COUNT; i++) {
+                    int xPos = i + MIN_TABLE_X_POS;
+                    layout.shiftedRows[i][y] = static_cast<uint16_t>(
+                        xPos >= 0 ? part << xPos : part >> -xPos);
+                }
+            }
+        }
+    }
+
+    return tables;
+}
+
+const ShapeTables& getShapeTables() {
+    static const ShapeTables tables = buildShapeTables();
+    return tables;
+}
+
+const ShapeLayout& getShapeLayout(const GameBatch& batch,
+                                  int lane,
+                                  uint8_t rotationIndex) {
+    return getShapeTables()
+        .layouts[batch.blockIndex[lane]][rotationIndex & 0b11];
+}
+
+int getTableIndex(int xPos) {
+    return std::min(std::max(xPos - MIN_TABLE_X_POS, 0),
+                    TABLE_X_POS_COUNT - 1);
+}
+
+// Sets collisions[lane] to 0xFFFF where the lane's block at the given
+// position would collide and to 0 where it fits. Same result as the
+// RowMasks isCollision for every lane.
+void testCollisions(const GameBatch& batch,
+                    const int16_t xPos[BATCH_LANES],
+                    const int16_t yPos[BATCH_LANES],
+                    const uint8_t rotationIndex[BATCH_LANES],
+                    uint16_t collisions[BATCH_LANES]) {
+    const ShapeTables& tables = getShapeTables();
+    alignas(32) uint16_t parts[PART_SIZE][BATCH_LANES];
+
+    // Gather each lane's shifted shape rows and test the board bounds
+    for (int lane = 0; lane < BATCH_LANES; lane++) {
+        const ShapeLayout& layout =
+            tables.layouts[batch.blockIndex[lane]][rotationIndex[lane] & 0b11];
+        const uint16_t* shiftedRows =
+            layout.shiftedRows[getTableIndex(xPos[lane])];
+        for (int y = 0; y < PART_SIZE; y++) {
+            parts[y][lane] = shiftedRows[y];
+        }
+
+        bool outOfBounds = xPos[lane] + layout.lowestX < 0 ||
+                           xPos[lane] + layout.highestX >= BOARD_WIDTH ||
+                           yPos[lane] + layout.highestY >= BOARD_HEIGHT;
+        collisions[lane] = outOfBounds ? 0xFFFF : 0;
+    }
+
+    // Sweep the board rows, every lane picks the shape row landing on it
+#ifdef __AVX2__
+    const __m256i laneYPos =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(yPos));
+    __m256i partVectors[PART_SIZE];
+    for (int y = 0; y < PART_SIZE; y++) {
+        partVectors[y] =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(parts[y]));
+    }
+
+    __m256i hits =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(collisions));
+    for (int row = 0; row < BOARD_HEIGHT; row++) {
+        __m256i partIndex = _mm256_sub_epi16(_mm256_set1_epi16(row), laneYPos);
+        __m256i blockRow = _mm256_setzero_si256();
+        for (int y = 0; y < PART_SIZE; y++) {
+            __m256i isPart =
+                _mm256_cmpeq_epi16(partIndex, _mm256_set1_epi16(y));
+            blockRow =
+                _mm256_or_si256(blockRow, _mm256_and_si256(isPart, partVectors[y]));
+        }
+
+        __m256i boardRow =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(batch.rows[row]));
+        hits = _mm256_or_si256(hits, _mm256_and_si256(boardRow, blockRow));
+    }
+
+    __m256i isFree = _mm256_cmpeq_epi16(hits, _mm256_setzero_si256());
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(collisions),
+                       _mm256_xor_si256(isFree, _mm256_set1_epi16(-1)));
+#else
+    for (int row = 0; row < BOARD_HEIGHT; row++) {
+        for (int lane = 0; lane < BATCH_LANES; lane++) {
+            int partIndex = row - yPos[lane];
+            uint16_t blockRow = 0;
+            for (int y = 0; y < PART_SIZE; y++) {
+                blockRow |= partIndex == y ? parts[y][lane] : 0;
+            }
+            collisions[lane] |= batch.rows[row][lane] & blockRow;
+        }
+    }
+
+    for (int lane = 0; lane < BATCH_LANES; lane++) {
+        collisions[lane] = collisions[lane] ? 0xFFFF : 0;
+    }
+#endif
+}
+
+int drawBlockIndex(BatchBlockGenerators& blockGenerators, int lane) {
+    std::uniform_int_distribution<int> blockDistribution(0, 6);
+    return blockDistribution(blockGenerators.generators[lane]);
+}
+
+// Same as assigning a new GameState, the current block is left alone
+void resetLane(GameBatch& batch, int lane) {
+    const GameState defaultState;
+
+    for (int y = 0; y < BOARD_HEIGHT; y++) {
+        batch.rows[y][lane] = 0;
+    }
+    batch.xPos[lane] = defaultState.xPos;
+    batch.yPos[lane] = defaultState.yPos;
+    batch.rotationIndex[lane] = defaultState.rotationIndex;
+    batch.gameOver[lane] = defaultState.gameOver;
+    batch.placeBlock[lane] = defaultState.placeBlock;
+    batch.canRotate[lane] = defaultState.canRotate;
+    batch.nextBlockIndex[lane] = defaultState.nextBlockIndex;
+    batch.score[lane] = defaultState.score;
+    batch.fallSpeed[lane] = defaultState.fallSpeed;
+    batch.fallSpeedAcc[lane] = defaultState.fallSpeedAcc;
+    batch.rotationSpeedAcc[lane] = defaultState.rotationSpeedAcc;
+}
+
+// The placement branch of updateGameState for one lane. Rare enough that it
+// is not worth vectorising.
+void lockLane(GameBatch& batch,
+              BatchBlockGenerators& blockGenerators,
+              int lane,
+              int xPos,
+              int yPos,
+              uint8_t rotationIndex) {
+    const ShapeLayout& lockLayout = getShapeLayout(batch, lane, rotationIndex);
+    const uint16_t* lockRows = lockLayout.shiftedRows[getTableIndex(xPos)];
+    for (int y = 0; y < PART_SIZE; y++) {
+        int row = yPos + y;
+        if (row >= 0 && row < BOARD_HEIGHT) {
+            batch.rows[row][lane] |= lockRows[y];
+        }
+    }
+
+    batch.placeBlock[lane] = false;
+    batch.yPos[lane] = 0;
+    batch.xPos[lane] = 5;
+    batch.rotationIndex[lane] = 0;
+
+    batch.blockIndex[lane] = static_cast<uint8_t>(batch.nextBlockIndex[lane]);
+    batch.nextBlockIndex[lane] = drawBlockIndex(blockGenerators, lane);
+
+    // updateGameState checks the spawn before removing full rows
+    const ShapeLayout& spawnLayout = getShapeLayout(batch, lane, 0);
+    const uint16_t* spawnRows = spawnLayout.shiftedRows[getTableIndex(5)];
+    for (int y = 0; y < PART_SIZE; y++) {
+        if (batch.rows[y][lane] & spawnRows[y]) {
+            batch.gameOver[lane] = true;
+        }
+    }
+
+    // Drop full rows, moving everything above them down
+    int fullRows = 0;
+    for (int y = BOARD_HEIGHT - 1; y >= 0; y--) {
+        uint16_t row = batch.rows[y][lane];
+        if (row == 0x3FF) {
+            fullRows++;
+            continue;
+        }
+        batch.rows[y + fullRows][lane] = row;
+    }
+    for (int y = 0; y < fullRows; y++) {
+        batch.rows[y][lane] = 0;
+    }
+
+    if (fullRows > 0) {
+        batch.score[lane] += fullRows * 100;
+        batch.fallSpeed[lane] += 0.01;
+    }
+}
+
+}  // namespace
+
+void initialiseBatch(GameBatch& batch,
+                     BatchBlockGenerators& blockGenerators,
+                     const uint32_t seeds[BATCH_LANES]) {
+    for (int lane = 0; lane < BATCH_LANES; lane++) {
+        blockGenerators.generators[lane].seed(seeds[lane]);
+        resetLane(batch, lane);
+
+        batch.blockIndex[lane] =
+            static_cast<uint8_t>(drawBlockIndex(blockGenerators, lane));
+        batch.nextBlockIndex[lane] = drawBlockIndex(blockGenerators, lane);
+    }
+}
+
+void stepBatch(GameBatch& batch,
+               BatchBlockGenerators& blockGenerators,
+               const uint8_t inputs[BATCH_LANES]) {
+    const float rotationSpeed = GameState().rotationSpeed;
+
+    alignas(32) uint8_t active[BATCH_LANES];
+    alignas(32) int16_t lockXPos[BATCH_LANES];
+    alignas(32) int16_t lockYPos[BATCH_LANES];
+    alignas(32) uint8_t lockRotationIndex[BATCH_LANES];
+    alignas(32) int16_t testXPos[BATCH_LANES];
+    alignas(32) int16_t testYPos[BATCH_LANES];
+    alignas(32) uint16_t isCollisionDown[BATCH_LANES];
+    alignas(32) uint16_t collisions[BATCH_LANES];
+
+    for (int lane = 0; lane < BATCH_LANES; lane++) {
+        active[lane] = !batch.gameOver[lane];
+        if (batch.gameOver[lane] && (inputs[lane] & INPUT_RIGHT)) {
+            resetLane(batch, lane);
+        }
+
+        // updateGameState locks the block where it was at the start
+        lockXPos[lane] = batch.xPos[lane];
+        lockYPos[lane] = batch.yPos[lane];
+        lockRotationIndex[lane] = batch.rotationIndex[lane];
+        testYPos[lane] = batch.yPos[lane] + 1;
+    }
+
+    testCollisions(batch, batch.xPos, testYPos, batch.rotationIndex,
+                   isCollisionDown);
+
+    // Left, then right from wherever left ended up
+    const int directions[2] = {-1, 1};
+    const int directionInputs[2] = {INPUT_LEFT, INPUT_RIGHT};
+    for (int i = 0; i < 2; i++) {
+        for (int lane = 0; lane < BATCH_LANES; lane++) {
+            testXPos[lane] = batch.xPos[lane] + directions[i];
+        }
+
+        testCollisions(batch, testXPos, batch.yPos, batch.rotationIndex,
+                       collisions);
+
+        for (int lane = 0; lane < BATCH_LANES; lane++) {
+            bool canMove = active[lane] && (inputs[lane] & directionInputs[i]) &&
+                           !collisions[lane];
+            batch.xPos[lane] = canMove ? testXPos[lane] : batch.xPos[lane];
+        }
+    }
+
+    // Rotation, trying each lane's kick table in order. Up wins over the
+    // counter clockwise and 180 degree keys like in updateGameState.
+    alignas(32) uint8_t rotating[BATCH_LANES];
+    alignas(32) uint8_t newRotationIndex[BATCH_LANES];
+    const WallKicks* wallKicks[BATCH_LANES];
+    for (int lane = 0; lane < BATCH_LANES; lane++) {
+        uint8_t rotateInputs =
+            inputs[lane] & (INPUT_UP | INPUT_ROTATE_CCW | INPUT_ROTATE_180);
+        RotationDirection direction =
+            inputs[lane] & INPUT_UP           ? ROTATE_CLOCKWISE
+            : inputs[lane] & INPUT_ROTATE_CCW ? ROTATE_COUNTER_CLOCKWISE
+                                              : ROTATE_180;
+        rotating[lane] = active[lane] && rotateInputs && batch.canRotate[lane];
+        newRotationIndex[lane] =
+            (batch.rotationIndex[lane] + ROTATION_STEPS[direction]) & 0b11;
+        wallKicks[lane] = &WALL_KICK_TABLES.kicks[batch.blockIndex[lane]]
+                                                 [batch.rotationIndex[lane]]
+                                                 [direction];
+        batch.canRotate[lane] = rotating[lane] ? false : batch.canRotate[lane];
+    }
+
+    for (int kick = 0; kick < MAX_WALL_KICK_TESTS; kick++) {
+        bool anyRotating = false;
+        for (int lane = 0; lane < BATCH_LANES; lane++) {
+            rotating[lane] = kick < wallKicks[lane]->count ? rotating[lane] : 0;
+            KickOffset offset = wallKicks[lane]->offsets[kick];
+            testXPos[lane] = batch.xPos[lane] + offset.x;
+            testYPos[lane] = batch.yPos[lane] + offset.y;
+            anyRotating |= rotating[lane] != 0;
+        }
+        if (!anyRotating) {
+            break;
+        }
+
+        testCollisions(batch, testXPos, testYPos, newRotationIndex,
+                       collisions);
+
+        for (int lane = 0; lane < BATCH_LANES; lane++) {
+            bool fits = rotating[lane] && !collisions[lane];
+            batch.xPos[lane] = fits ? testXPos[lane] : batch.xPos[lane];
+            batch.yPos[lane] = fits ? testYPos[lane] : batch.yPos[lane];
+            batch.rotationIndex[lane] =
+                fits ? newRotationIndex[lane] : batch.rotationIndex[lane];
+            rotating[lane] = fits ? false : rotating[lane];
+        }
+    }
+
+    for (int lane = 0; lane < BATCH_LANES; lane++) {
+        if (!active[lane]) {
+            continue;
+        }
+
+        if (isCollisionDown[lane] && batch.placeBlock[lane]) {
+            lockLane(batch, blockGenerators, lane, lockXPos[lane],
+                     lockYPos[lane], lockRotationIndex[lane]);
+            continue;
+        }
+
+        if (inputs[lane] & INPUT_DOWN) {
+            batch.yPos[lane] += isCollisionDown[lane] ? 0 : 1;
+            batch.placeBlock[lane] |= isCollisionDown[lane] ? 1 : 0;
+        }
+
+        batch.fallSpeedAcc[lane] += batch.fallSpeed[lane];
+        batch.rotationSpeedAcc[lane] += rotationSpeed;
+
+        if (batch.rotationSpeedAcc[lane] >= 1.0) {
+            batch.rotationSpeedAcc[lane] = 0;
+            batch.canRotate[lane] = true;
+        }
+
+        if (batch.fallSpeedAcc[lane] >= 1.0) {
+            if (isCollisionDown[lane]) {
+                batch.placeBlock[lane] = true;
+            } else {
+                batch.yPos[lane] += 1;
+                batch.fallSpeedAcc[lane] = 0;
+            }
+        }
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+
+#include "game.h"
+
+// Games stepped in lockstep, one 16 bit lane each of a 256 bit register
+constexpr int BATCH_LANES = 16;
+
+enum BatchInput {
+    INPUT_LEFT = 1 << 0,
+    INPUT_RIGHT = 1 << 1,
+    INPUT_UP = 1 << 2,
+    INPUT_DOWN = 1 << 3,
+    INPUT_ROTATE_CCW = 1 << 4,
+    INPUT_ROTATE_180 = 1 << 5,
+};
+
+// BATCH_LANES independent games stored as structure of arrays. Index
+// [lane] is one game, rows[y] holds row y of every game next to each other.
+struct GameBatch {
+    alignas(32) uint16_t rows[BOARD_HEIGHT][BATCH_LANES];
+    alignas(32) int16_t xPos[BATCH_LANES];
+    alignas(32) int16_t yPos[BATCH_LANES];
+    alignas(32) uint8_t rotationIndex[BATCH_LANES];
+    alignas(32) uint8_t blockIndex[BATCH_LANES];
+    alignas(32) uint8_t gameOver[BATCH_LANES];
+    alignas(32) uint8_t placeBlock[BATCH_LANES];
+    alignas(32) uint8_t canRotate[BATCH_LANES];
+    alignas(32) int nextBlockIndex[BATCH_LANES];
+    alignas(32) int score[BATCH_LANES];
+    alignas(32) float fallSpeed[BATCH_LANES];
+    alignas(32) float fallSpeedAcc[BATCH_LANES];
+    alignas(32) float rotationSpeedAcc[BATCH_LANES];
+};
+
+// Block sequence of every lane of a GameBatch. Kept apart from it since an
+// mt19937 is ~5 KB and is only touched when a block locks.
+struct BatchBlockGenerators {
+    std::mt19937 generators[BATCH_LANES];
+};
+
+// Starts every lane the way main starts a game, with the block sequence
+// seedBlockGenerator(seeds[lane]) would give
+void initialiseBatch(GameBatch& batch,
+                     BatchBlockGenerators& blockGenerators,
+                     const uint32_t seeds[BATCH_LANES]);
+
+// Advances every lane by one tick, the same as calling updateGameState on
+// each game with the matching BatchInput bits
+void stepBatch(GameBatch& batch,
+               BatchBlockGenerators& blockGenerators,
+               const uint8_t inputs[BATCH_LANES]);
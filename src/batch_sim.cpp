@@ -0,0 +1,316 @@
+// Runs many games through the batched simulator and reports throughput.
+//
+// Usage: BatchSim [--games N] [--ticks N] [--seed N] [--validate]
+//                 [--telemetry FILE]
+//
+// With --validate every game is also run through updateGameState and the
+// two are compared field by field after every tick. With --telemetry the
+// updateGameState runs record their placements to FILE.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "batch.h"
+#include "game.h"
+#include "telemetry.h"
+
+// Everything updateGameState carries from one tick to the next
+struct GameSnapshot {
+    RowMasks rows;
+    int xPos;
+    int yPos;
+    int rotationIndex;
+    int blockIndex;
+    int nextBlockIndex;
+    int score;
+    bool gameOver;
+    bool placeBlock;
+    bool canRotate;
+    float fallSpeed;
+    float fallSpeedAcc;
+    float rotationSpeedAcc;
+};
+
+bool operator==(const GameSnapshot& a, const GameSnapshot& b) {
+    // Floats are compared bit for bit
+    return a.rows == b.rows && a.xPos == b.xPos && a.yPos == b.yPos &&
+           a.rotationIndex == b.rotationIndex &&
+           a.blockIndex == b.blockIndex &&
+           a.nextBlockIndex == b.nextBlockIndex && a.score == b.score &&
+           a.gameOver == b.gameOver && a.placeBlock == b.placeBlock &&
+           a.canRotate == b.canRotate &&
+           std::memcmp(&a.fallSpeed, &b.fallSpeed, sizeof(float)) == 0 &&
+           std::memcmp(&a.fallSpeedAcc, &b.fallSpeedAcc, sizeof(float)) == 0 &&
+           std::memcmp(&a.rotationSpeedAcc, &b.rotationSpeedAcc,
+                       sizeof(float)) == 0;
+}
+
+std::ostream& operator<<(std::ostream& stream, const GameSnapshot& snapshot) {
+    stream << "block " << snapshot.blockIndex << " next "
+           << snapshot.nextBlockIndex << " x " << snapshot.xPos << " y "
+           << snapshot.yPos << " rotation " << snapshot.rotationIndex
+           << " score " << snapshot.score << " gameOver " << snapshot.gameOver
+           << " placeBlock " << snapshot.placeBlock << " canRotate "
+           << snapshot.canRotate << " fallSpeed " << snapshot.fallSpeed
+           << " fallSpeedAcc " << snapshot.fallSpeedAcc
+           << " rotationSpeedAcc " << snapshot.rotationSpeedAcc << std::endl;
+    for (const auto& row : snapshot.rows) {
+        for (int x = 0; x < BOARD_WIDTH; x++) {
+            stream << (row & (1 << x) ? '#' : '.');
+        }
+        stream << std::endl;
+    }
+    return stream;
+}
+
+GameSnapshot takeSnapshot(const GameState& gameState) {
+    GameSnapshot snapshot;
+    snapshot.rows = convertMatrixBitsToRowMasks(gameState.playingFieldMatrixBits);
+    snapshot.xPos = gameState.xPos;
+    snapshot.yPos = gameState.yPos;
+    snapshot.rotationIndex = gameState.rotationIndex;
+    snapshot.blockIndex = getCurrentBlockIndex();
+    snapshot.nextBlockIndex = gameState.nextBlockIndex;
+    snapshot.score = gameState.score;
+    snapshot.gameOver = gameState.gameOver;
+    snapshot.placeBlock = gameState.placeBlock;
+    snapshot.canRotate = gameState.canRotate;
+    snapshot.fallSpeed = gameState.fallSpeed;
+    snapshot.fallSpeedAcc = gameState.fallSpeedAcc;
+    snapshot.rotationSpeedAcc = gameState.rotationSpeedAcc;
+    return snapshot;
+}
+
+GameSnapshot takeSnapshot(const GameBatch& batch, int lane) {
+    GameSnapshot snapshot;
+    for (int y = 0; y < BOARD_HEIGHT; y++) {
+        snapshot.rows[y] = batch.rows[y][lane];
+    }
+    snapshot.xPos = batch.xPos[lane];
+    snapshot.yPos = batch.yPos[lane];
+    snapshot.rotationIndex = batch.rotationIndex[lane];
+    snapshot.blockIndex = batch.blockIndex[lane];
+    snapshot.nextBlockIndex = batch.nextBlockIndex[lane];
+    snapshot.score = batch.score[lane];
+    snapshot.gameOver = batch.gameOver[lane];
+    snapshot.placeBlock = batch.placeBlock[lane];
+    snapshot.canRotate = batch.canRotate[lane];
+    snapshot.fallSpeed = batch.fallSpeed[lane];
+    snapshot.fallSpeedAcc = batch.fallSpeedAcc[lane];
+    snapshot.rotationSpeedAcc = batch.rotationSpeedAcc[lane];
+    return snapshot;
+}
+
+InputState convertInputs(uint8_t inputs) {
+    InputState inputState;
+    inputState.leftArrowDown = inputs & INPUT_LEFT;
+    inputState.rightArrowDown = inputs & INPUT_RIGHT;
+    inputState.upArrowDown = inputs & INPUT_UP;
+    inputState.downArrowDown = inputs & INPUT_DOWN;
+    inputState.counterClockwiseDown = inputs & INPUT_ROTATE_CCW;
+    inputState.rotate180Down = inputs & INPUT_ROTATE_180;
+    return inputState;
+}
+
+// Runs one game through updateGameState, calling onTick after every tick
+template <typename OnTick>
+void runScalarGame(uint32_t seed,
+                   const std::vector<uint8_t>& inputs,
+                   int game,
+                   int gameCount,
+                   TelemetryStream* telemetryStream,
+                   OnTick onTick) {
+    GameState gameState;
+    gameState.telemetryStream = telemetryStream;
+    seedBlockGenerator(seed);
+    setNextBlockIndex(gameState.nextBlockIndex);
+    setCurrentBlockBitmap(gameState.nextBlockIndex);
+    setNextBlockIndex(gameState.nextBlockIndex);
+
+    size_t tickCount = inputs.size() / gameCount;
+    for (size_t tick = 0; tick < tickCount; tick++) {
+        InputState inputState = convertInputs(inputs[tick * gameCount + game]);
+        updateGameState(gameState, inputState);
+        onTick(tick, gameState);
+    }
+}
+
+void printUsage() {
+    std::cerr << "Usage: BatchSim [--games N] [--ticks N] [--seed N] "
+                 "[--validate] [--telemetry FILE]"
+              << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    int gameCount = 4096;
+    int tickCount = 2000;
+    uint32_t seed = 1;
+    bool validate = false;
+    std::string telemetryFileName;
+
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        if (argument == "--validate") {
+            validate = true;
+            continue;
+        }
+
+        if (i + 1 >= argc) {
+            printUsage();
+            return 1;
+        }
+
+        std::string value = argv[++i];
+        if (argument == "--games") {
+            gameCount = std::atoi(value.c_str());
+        } else if (argument == "--ticks") {
+            tickCount = std::atoi(value.c_str());
+        } else if (argument == "--seed") {
+            seed = std::strtoul(value.c_str(), NULL, 10);
+        } else if (argument == "--telemetry") {
+            telemetryFileName = value;
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+
+    // Round up to whole batches
+    int batchCount = (gameCount + BATCH_LANES - 1) / BATCH_LANES;
+    gameCount = batchCount * BATCH_LANES;
+
+    std::vector<uint32_t> seeds(gameCount);
+    for (int game = 0; game < gameCount; game++) {
+        seeds[game] = seed + game;
+    }
+
+    // Random key presses, laid out [tick][game]
+    std::mt19937 inputGenerator(seed);
+    std::vector<uint8_t> inputs(static_cast<size_t>(tickCount) * gameCount);
+    for (auto& input : inputs) {
+        uint32_t bits = inputGenerator();
+        input = 0;
+        input |= (bits & 0x3) == 0 ? INPUT_LEFT : 0;
+        input |= (bits & 0xC) == 0 ? INPUT_RIGHT : 0;
+        input |= (bits & 0x30) == 0 ? INPUT_UP : 0;
+        input |= (bits & 0xC0) == 0 ? INPUT_DOWN : 0;
+        input |= (bits & 0x300) == 0 ? INPUT_ROTATE_CCW : 0;
+        input |= (bits & 0xC00) == 0 ? INPUT_ROTATE_180 : 0;
+    }
+
+    std::vector<GameBatch> batches(batchCount);
+    std::vector<BatchBlockGenerators> blockGenerators(batchCount);
+    for (int i = 0; i < batchCount; i++) {
+        initialiseBatch(batches[i], blockGenerators[i],
+                        &seeds[i * BATCH_LANES]);
+    }
+
+    auto batchStartTime = std::chrono::steady_clock::now();
+    for (int tick = 0; tick < tickCount; tick++) {
+        const uint8_t* tickInputs = &inputs[static_cast<size_t>(tick) * gameCount];
+        for (int i = 0; i < batchCount; i++) {
+            stepBatch(batches[i], blockGenerators[i],
+                      tickInputs + i * BATCH_LANES);
+        }
+    }
+    std::chrono::duration<double> batchTime =
+        std::chrono::steady_clock::now() - batchStartTime;
+
+    TelemetryWriter telemetryWriter;
+    bool recordTelemetry = !telemetryFileName.empty();
+    if (recordTelemetry && !telemetryWriter.open(telemetryFileName)) {
+        std::cerr << "Failed to open " << telemetryFileName << std::endl;
+        return 1;
+    }
+    uint64_t droppedEvents = 0;
+
+    // Validation replays one batch at a time so only BATCH_LANES games of
+    // snapshots are held. The scalar games share the global block generator
+    // and current block, so they run one after another against them.
+    std::vector<GameSnapshot> batchSnapshots;
+    GameBatch validationBatch;
+    BatchBlockGenerators validationBlockGenerators;
+    long long mismatches = 0;
+    auto scalarStartTime = std::chrono::steady_clock::now();
+    for (int game = 0; game < gameCount; game++) {
+        int lane = game % BATCH_LANES;
+        if (validate && lane == 0) {
+            batchSnapshots.resize(static_cast<size_t>(tickCount) * BATCH_LANES);
+            initialiseBatch(validationBatch, validationBlockGenerators,
+                            &seeds[game]);
+            for (int tick = 0; tick < tickCount; tick++) {
+                stepBatch(validationBatch, validationBlockGenerators,
+                          &inputs[static_cast<size_t>(tick) * gameCount + game]);
+                for (int i = 0; i < BATCH_LANES; i++) {
+                    batchSnapshots[static_cast<size_t>(tick) * BATCH_LANES + i] =
+                        takeSnapshot(validationBatch, i);
+                }
+            }
+        }
+
+        // Every game gets its own stream, the writer thread drains and
+        // deletes it once the game is over
+        TelemetryStream* telemetryStream = nullptr;
+        if (recordTelemetry) {
+            telemetryStream = new TelemetryStream();
+            telemetryStream->gameId = game;
+            telemetryWriter.addStream(*telemetryStream);
+        }
+
+        runScalarGame(seeds[game], inputs, game, gameCount,
+                      telemetryStream,
+                      [&](size_t tick, const GameState& gameState) {
+                          if (!validate) {
+                              return;
+                          }
+
+                          GameSnapshot expected = takeSnapshot(gameState);
+                          const GameSnapshot& actual =
+                              batchSnapshots[tick * BATCH_LANES + lane];
+                          if (!(expected == actual) && mismatches++ == 0) {
+                              std::cerr << "Mismatch in game " << game
+                                        << " at tick " << tick << std::endl
+                                        << "updateGameState: " << expected
+                                        << "stepBatch: " << actual;
+                          }
+                      });
+
+        if (telemetryStream) {
+            droppedEvents += telemetryStream->droppedEvents;
+            telemetryWriter.releaseStream(telemetryStream);
+        }
+    }
+    std::chrono::duration<double> scalarTime =
+        std::chrono::steady_clock::now() - scalarStartTime;
+    telemetryWriter.close();
+
+    if (droppedEvents > 0) {
+        std::cerr << "Dropped " << droppedEvents << " telemetry events"
+                  << std::endl;
+    }
+
+    double gameTicks = static_cast<double>(gameCount) * tickCount;
+    std::cout << gameCount << " games, " << tickCount << " ticks" << std::endl;
+    std::cout << "stepBatch:       " << gameTicks / batchTime.count()
+              << " game ticks/s" << std::endl;
+    if (!validate) {
+        std::cout << "updateGameState: " << gameTicks / scalarTime.count()
+                  << " game ticks/s" << std::endl;
+        return 0;
+    }
+
+    if (mismatches > 0) {
+        std::cout << "Validation failed: " << mismatches
+                  << " mismatched game ticks" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Validation passed" << std::endl;
+    return 0;
+}
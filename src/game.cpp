@@ -1 +1,532 @@
 #include "game.h"
+#include "telemetry.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+#include <random>
+#include <utility>
+#include <vector>
+
+const ShapeBits I_TETROID[4] = {
+    TETROID_SHAPES[I][0],
+    TETROID_SHAPES[I][1],
+    TETROID_SHAPES[I][2],
+    TETROID_SHAPES[I][3],
+};
+
+const ShapeBits J_TETROID[4] = {
+    TETROID_SHAPES[J][0],
+    TETROID_SHAPES[J][1],
+    TETROID_SHAPES[J][2],
+    TETROID_SHAPES[J][3],
+};
+
+const ShapeBits L_TETROID[4] = {
+    TETROID_SHAPES[L][0],
+    TETROID_SHAPES[L][1],
+    TETROID_SHAPES[L][2],
+    TETROID_SHAPES[L][3],
+};
+
+const ShapeBits O_TETROID[4] = {
+    TETROID_SHAPES[O][0],
+    TETROID_SHAPES[O][1],
+    TETROID_SHAPES[O][2],
+    TETROID_SHAPES[O][3],
+};
+
+const ShapeBits S_TETROID[4] = {
+    TETROID_SHAPES[S][0],
+    TETROID_SHAPES[S][1],
+    TETROID_SHAPES[S][2],
+    TETROID_SHAPES[S][3],
+};
+
+const ShapeBits T_TETROID[4] = {
+    TETROID_SHAPES[T][0],
+    TETROID_SHAPES[T][1],
+    TETROID_SHAPES[T][2],
+    TETROID_SHAPES[T][3],
+};
+
+const ShapeBits Z_TETROID[4] = {
+    TETROID_SHAPES[Z][0],
+    TETROID_SHAPES[Z][1],
+    TETROID_SHAPES[Z][2],
+    TETROID_SHAPES[Z][3],
+};
+
+const ShapeBits* availableBlocks[7] = {
+    I_TETROID, J_TETROID, L_TETROID, O_TETROID, S_TETROID, T_TETROID, Z_TETROID,
+};
+
+const ShapeBits* currentBlockBitmap[4];
+
+// Piece sequence, seeded from the clock unless seedBlockGenerator is called
+static std::mt19937 blockGenerator(time(nullptr));
+static std::uniform_int_distribution<int> blockDistribution(0, 6);
+
+void clearInputs(InputState& inputState) {
+    inputState.rightArrowDown = false;
+    inputState.leftArrowDown = false;
+    inputState.downArrowDown = false;
+    inputState.upArrowDown = false;
+    inputState.counterClockwiseDown = false;
+    inputState.rotate180Down = false;
+}
+
+MatrixBits convertShapeToMatrixBits(ShapeBits block, int xPos, int yPos) {
+    std::bitset<160> board;
+    std::bitset<PART_SIZE> parts[4];
+
+    parts[0] = (block >> (SHIFT_SIZE - PART_SIZE)).to_ulong();
+    parts[1] = (block >> (SHIFT_SIZE - PART_SIZE * 2)).to_ulong();
+    parts[2] = (block >> (SHIFT_SIZE - PART_SIZE * 3)).to_ulong();
+    parts[3] = (block >> (SHIFT_SIZE - PART_SIZE * 4)).to_ulong();
+
+    board |= std::bitset<160>(parts[0].to_ullong()) << (30);
+    board |= std::bitset<160>(parts[1].to_ullong()) << (20);
+    board |= std::bitset<160>(parts[2].to_ullong()) << (10);
+    board |= std::bitset<160>(parts[3].to_ullong());
+
+    int shiftSize = (xPos + (yPos * 10));
+    if (shiftSize <= 0) {
+        return (board >> abs(shiftSize));
+    }
+
+    return (board << (xPos + (yPos * 10)));
+}
+
+bool isCollision(ShapeBits shapeBits,
+                 MatrixBits playingFieldMatrixBits,
+                 int xPos,
+                 int yPos) {
+    MatrixBits matrixBits = convertShapeToMatrixBits(shapeBits, xPos, yPos);
+
+    for (int y = 0; y < 4; y++) {
+        for (int x = 0; x < 4; x++) {
+            if (shapeBits.test(y * 4 + x)) {
+                if ((xPos + x) >= 10) {
+                    return true;
+                }
+
+                if ((xPos + x) < 0) {
+                    return true;
+                }
+
+                if ((yPos + y) >= 16) {
+                    return true;
+                }
+            }
+        }
+    }
+    return (matrixBits & playingFieldMatrixBits).any();
+}
+
+RowMasks convertMatrixBitsToRowMasks(const MatrixBits& matrixBits) {
+    // Split into 64 bit words once, rows are then cut out of the words
+    constexpr int WORD_COUNT = (MATRIX_BITS_SIZE + 63) / 64;
+    const MatrixBits wordMask(~0ull);
+    unsigned long long words[WORD_COUNT + 1] = {};
+    for (int word = 0; word < WORD_COUNT; word++) {
+        words[word] = ((matrixBits >> (word * 64)) & wordMask).to_ullong();
+    }
+
+    RowMasks rowMasks;
+    for (int y = 0; y < BOARD_HEIGHT; y++) {
+        int word = y * BOARD_WIDTH / 64;
+        int offset = y * BOARD_WIDTH % 64;
+        unsigned long long bits = words[word] >> offset;
+        if (offset > 64 - BOARD_WIDTH) {
+            bits |= words[word + 1] << (64 - offset);
+        }
+        rowMasks[y] = static_cast<uint16_t>(bits & 0x3FF);
+    }
+    return rowMasks;
+}
+
+// Same result as the MatrixBits version, but tests one shape row at a time
+// against the board row it lands on. Rows above the board never collide.
+bool isCollision(ShapeBits shapeBits,
+                 const RowMasks& rowMasks,
+                 int xPos,
+                 int yPos) {
+    unsigned long shape = shapeBits.to_ulong();
+
+    for (int y = 0; y < 4; y++) {
+        unsigned int part = (shape >> (y * PART_SIZE)) & 0xF;
+        if (part == 0) {
+            continue;
+        }
+
+        int lowestX = part & 0x1 ? 0 : part & 0x2 ? 1 : part & 0x4 ? 2 : 3;
+        int highestX = part & 0x8 ? 3 : part & 0x4 ? 2 : part & 0x2 ? 1 : 0;
+        if (xPos + lowestX < 0 || xPos + highestX >= BOARD_WIDTH ||
+            yPos + y >= BOARD_HEIGHT) {
+            return true;
+        }
+
+        if (yPos + y < 0) {
+            continue;
+        }
+
+        unsigned int partMask = xPos >= 0 ? part << xPos : part >> -xPos;
+        if (rowMasks[yPos + y] & partMask) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Spot checks against the published SRS tables, y grows down here
+static_assert(WALL_KICK_TABLES.kicks[T][2][ROTATE_CLOCKWISE].offsets[2].x == -1 &&
+                  WALL_KICK_TABLES.kicks[T][2][ROTATE_CLOCKWISE].offsets[2].y == -1,
+              "T 0->R third test should be (-1, +1)");
+static_assert(WALL_KICK_TABLES.kicks[I][2][ROTATE_CLOCKWISE].offsets[4].x == 1 &&
+                  WALL_KICK_TABLES.kicks[I][2][ROTATE_CLOCKWISE].offsets[4].y == -2,
+              "I 0->R fifth test should be (+1, +2)");
+static_assert(WALL_KICK_TABLES.kicks[O][0][ROTATE_180].count == 1,
+              "O should never kick");
+
+template <typename Board>
+static void rotateWithWallKicks(int blockIndex,
+                                const Board& playingFieldMatrixBits,
+                                int& xPos,
+                                int& yPos,
+                                uint8_t& rotationIndex,
+                                RotationDirection direction) {
+    uint8_t newRotationIndex =
+        (rotationIndex + ROTATION_STEPS[direction]) & 0b11;
+    ShapeBits shapeBits = TETROID_SHAPES[blockIndex][newRotationIndex];
+    const WallKicks& wallKicks =
+        WALL_KICK_TABLES.kicks[blockIndex][rotationIndex][direction];
+
+    // Fixed trip count so the compiler can unroll the tests
+    for (int i = 0; i < MAX_WALL_KICK_TESTS; i++) {
+        if (i >= wallKicks.count) {
+            return;
+        }
+
+        int newXPos = xPos + wallKicks.offsets[i].x;
+        int newYPos = yPos + wallKicks.offsets[i].y;
+        if (!isCollision(shapeBits, playingFieldMatrixBits, newXPos, newYPos)) {
+            xPos = newXPos;
+            yPos = newYPos;
+            rotationIndex = newRotationIndex;
+            return;
+        }
+    }
+}
+
+void setRotationData(int blockIndex,
+                     const MatrixBits& playingFieldMatrixBits,
+                     int& xPos,
+                     int& yPos,
+                     uint8_t& rotationIndex,
+                     RotationDirection direction) {
+    rotateWithWallKicks(blockIndex, playingFieldMatrixBits, xPos, yPos,
+                        rotationIndex, direction);
+}
+
+void setRotationData(int blockIndex,
+                     const RowMasks& rowMasks,
+                     int& xPos,
+                     int& yPos,
+                     uint8_t& rotationIndex,
+                     RotationDirection direction) {
+    rotateWithWallKicks(blockIndex, rowMasks, xPos, yPos, rotationIndex,
+                        direction);
+}
+
+int getStackHeight(const MatrixBits& playingFieldMatrixBits) {
+    // Find the first filled cell a 64 bit word at a time
+    const MatrixBits wordMask(~0ull);
+    for (int word = 0; word * 64 < MATRIX_BITS_SIZE; word++) {
+        unsigned long long bits =
+            ((playingFieldMatrixBits >> (word * 64)) & wordMask).to_ullong();
+        if (bits == 0) {
+            continue;
+        }
+
+        int i = word * 64;
+        while (!(bits & 1)) {
+            bits >>= 1;
+            i++;
+        }
+        return BOARD_HEIGHT - i / BOARD_WIDTH;
+    }
+    return 0;
+}
+
+void checkForFullRows(MatrixBits playingFieldMatrixBits,
+                      std::vector<int>& fullRows) {
+    for (int y = 0; y < 16; y++) {
+        bool hasFullRow = true;
+        for (int x = 0; x < 10; x++) {
+            int i = y * BOARD_WIDTH + x;
+            if (!playingFieldMatrixBits.test(i)) {
+                hasFullRow = false;
+            }
+        }
+
+        if (hasFullRow) {
+            fullRows.push_back(y);
+        }
+    }
+}
+
+void removeAndShiftRows(MatrixBits& playingFieldMatrixBits,
+                        std::vector<int>& fullRows) {
+    if (fullRows.size() <= 0) {
+        return;
+    }
+    for (const auto& fullRow : fullRows) {
+        for (int i = fullRow * 10; i < (fullRow * 10) + 10; i++) {
+            playingFieldMatrixBits.reset(i);
+        }
+
+        MatrixBits tempPlayingFieldMatrixBits;
+        tempPlayingFieldMatrixBits = playingFieldMatrixBits;
+
+        tempPlayingFieldMatrixBits <<= (160 - fullRow * 10);
+        tempPlayingFieldMatrixBits >>= (160 - fullRow * 10);
+        tempPlayingFieldMatrixBits <<= 10;
+
+        playingFieldMatrixBits >>= ((fullRow) * 10);
+        playingFieldMatrixBits <<= ((fullRow) * 10);
+        playingFieldMatrixBits |= tempPlayingFieldMatrixBits;
+    }
+}
+
+void setCurrentBlockBitmap(int nextBlockIndex) {
+    const std::bitset<16>* shapeBits = availableBlocks[nextBlockIndex];
+    currentBlockBitmap[0] = &shapeBits[0];
+    currentBlockBitmap[1] = &shapeBits[1];
+    currentBlockBitmap[2] = &shapeBits[2];
+    currentBlockBitmap[3] = &shapeBits[3];
+}
+
+int getCurrentBlockIndex() {
+    for (int blockIndex = 0; blockIndex < 7; blockIndex++) {
+        if (currentBlockBitmap[0] == availableBlocks[blockIndex]) {
+            return blockIndex;
+        }
+    }
+    return 0;
+}
+
+void seedBlockGenerator(uint32_t seed) {
+    blockGenerator.seed(seed);
+    blockDistribution.reset();
+}
+
+void setNextBlockIndex(int& nextBlockIndex) {
+    // Generate random number
+    nextBlockIndex = blockDistribution(blockGenerator);
+}
+
+static void pushGameEvent(GameState& gameState, GameEvent event) {
+    if (gameState.eventQueue) {
+        gameState.eventQueue->push(event);
+    }
+}
+
+void updateGameState(GameState& gameState, InputState& inputState) {
+    if(gameState.gameOver) {
+        if(inputState.rightArrowDown) {
+            TelemetryStream* telemetryStream = gameState.telemetryStream;
+            GameEventQueue* eventQueue = gameState.eventQueue;
+            gameState = *new GameState();
+            gameState.telemetryStream = telemetryStream;
+            gameState.eventQueue = eventQueue;
+        }
+        return;
+    }
+
+    // The block is locked where it was at the start of the tick
+    int lockXPos = gameState.xPos;
+    int lockYPos = gameState.yPos;
+    uint8_t lockRotationIndex = gameState.rotationIndex;
+    gameState.framesSincePlace++;
+
+    gameState.shapeBits = *currentBlockBitmap[gameState.rotationIndex];
+    gameState.matrixBits = convertShapeToMatrixBits(
+        gameState.shapeBits, gameState.xPos, gameState.yPos);
+
+    gameState.isCollisionDown =
+        isCollision(gameState.shapeBits, gameState.playingFieldMatrixBits,
+                    gameState.xPos, gameState.yPos + 1);
+
+    if (inputState.leftArrowDown) {
+        if (!isCollision(gameState.shapeBits, gameState.playingFieldMatrixBits,
+                         gameState.xPos - 1, gameState.yPos)) {
+            gameState.xPos -= 1;
+            pushGameEvent(gameState, EVENT_MOVE);
+        }
+    }
+
+    if (inputState.rightArrowDown) {
+        if (!isCollision(gameState.shapeBits, gameState.playingFieldMatrixBits,
+                         gameState.xPos + 1, gameState.yPos)) {
+            gameState.xPos += 1;
+            pushGameEvent(gameState, EVENT_MOVE);
+        }
+    }
+
+    bool rotateDown = inputState.upArrowDown ||
+                      inputState.counterClockwiseDown ||
+                      inputState.rotate180Down;
+    if (rotateDown && gameState.canRotate) {
+        RotationDirection direction =
+            inputState.upArrowDown            ? ROTATE_CLOCKWISE
+            : inputState.counterClockwiseDown ? ROTATE_COUNTER_CLOCKWISE
+                                              : ROTATE_180;
+        uint8_t previousRotationIndex = gameState.rotationIndex;
+        // Every kick is tested against the same board, split it into row
+        // masks once
+        RowMasks rowMasks =
+            convertMatrixBitsToRowMasks(gameState.playingFieldMatrixBits);
+        setRotationData(getCurrentBlockIndex(), rowMasks, gameState.xPos,
+                        gameState.yPos, gameState.rotationIndex, direction);
+        gameState.canRotate = false;
+
+        if (gameState.rotationIndex != previousRotationIndex) {
+            pushGameEvent(gameState, EVENT_ROTATE);
+        }
+    }
+
+    if (gameState.isCollisionDown && gameState.placeBlock) {
+        int lockBlockIndex = getCurrentBlockIndex();
+        int previousScore = gameState.score;
+
+        if (currentBlockBitmap[0] == &I_TETROID[0]) {
+            gameState.tetroidMatrixBits.IMatrixBits |= gameState.matrixBits;
+        }
+
+        if (currentBlockBitmap[0] == &J_TETROID[0]) {
+            gameState.tetroidMatrixBits.JMatrixBits |= gameState.matrixBits;
+        }
+
+        if (currentBlockBitmap[0] == &L_TETROID[0]) {
+            gameState.tetroidMatrixBits.LMatrixBits |= gameState.matrixBits;
+        }
+
+        if (currentBlockBitmap[0] == &O_TETROID[0]) {
+            gameState.tetroidMatrixBits.OMatrixBits |= gameState.matrixBits;
+        }
+
+        if (currentBlockBitmap[0] == &S_TETROID[0]) {
+            gameState.tetroidMatrixBits.SMatrixBits |= gameState.matrixBits;
+        }
+
+        if (currentBlockBitmap[0] == &T_TETROID[0]) {
+            gameState.tetroidMatrixBits.TMatrixBits |= gameState.matrixBits;
+        }
+
+        if (currentBlockBitmap[0] == &Z_TETROID[0]) {
+            gameState.tetroidMatrixBits.ZMatrixBits |= gameState.matrixBits;
+        }
+
+        gameState.playingFieldMatrixBits |=
+            gameState.tetroidMatrixBits.IMatrixBits |
+            gameState.tetroidMatrixBits.JMatrixBits |
+            gameState.tetroidMatrixBits.LMatrixBits |
+            gameState.tetroidMatrixBits.OMatrixBits |
+            gameState.tetroidMatrixBits.SMatrixBits |
+            gameState.tetroidMatrixBits.TMatrixBits |
+            gameState.tetroidMatrixBits.ZMatrixBits;
+
+        pushGameEvent(gameState, EVENT_LOCK);
+
+        gameState.isCollisionDown = false;
+        gameState.placeBlock = false;
+        gameState.yPos = 0;
+        gameState.xPos = 5;
+        gameState.rotationIndex = 0;
+
+        setCurrentBlockBitmap(gameState.nextBlockIndex);
+
+        setNextBlockIndex(gameState.nextBlockIndex);
+
+        ShapeBits shapeBits = *currentBlockBitmap[gameState.rotationIndex];
+        MatrixBits matrixBits = convertShapeToMatrixBits(
+            shapeBits, gameState.xPos, gameState.yPos);
+
+        if((matrixBits & gameState.playingFieldMatrixBits).any()) {
+            gameState.gameOver = true;
+        }
+
+        std::vector<int> fullRows;
+        checkForFullRows(gameState.playingFieldMatrixBits, fullRows);
+        if(fullRows.size() > 0) {
+            removeAndShiftRows(gameState.tetroidMatrixBits.IMatrixBits, fullRows);
+            removeAndShiftRows(gameState.tetroidMatrixBits.JMatrixBits, fullRows);
+            removeAndShiftRows(gameState.tetroidMatrixBits.LMatrixBits, fullRows);
+            removeAndShiftRows(gameState.tetroidMatrixBits.OMatrixBits, fullRows);
+            removeAndShiftRows(gameState.tetroidMatrixBits.SMatrixBits, fullRows);
+            removeAndShiftRows(gameState.tetroidMatrixBits.TMatrixBits, fullRows);
+            removeAndShiftRows(gameState.tetroidMatrixBits.ZMatrixBits, fullRows);
+
+            gameState.playingFieldMatrixBits =
+                gameState.tetroidMatrixBits.IMatrixBits |
+                gameState.tetroidMatrixBits.JMatrixBits |
+                gameState.tetroidMatrixBits.LMatrixBits |
+                gameState.tetroidMatrixBits.OMatrixBits |
+                gameState.tetroidMatrixBits.SMatrixBits |
+                gameState.tetroidMatrixBits.TMatrixBits |
+                gameState.tetroidMatrixBits.ZMatrixBits;
+
+            // Update score
+            gameState.score += (fullRows.size() * 100);
+            gameState.fallSpeed += 0.01;
+
+            pushGameEvent(gameState, EVENT_LINE_CLEAR);
+
+        }
+
+        if (gameState.telemetryStream) {
+            PlacementEvent event;
+            event.blockIndex = static_cast<uint8_t>(lockBlockIndex);
+            event.rotationIndex = lockRotationIndex;
+            event.xPos = static_cast<int8_t>(lockXPos);
+            event.yPos = static_cast<int8_t>(lockYPos);
+            event.framesToPlace = static_cast<uint16_t>(
+                std::min(gameState.framesSincePlace, int(UINT16_MAX)));
+            event.rowsCleared = static_cast<uint8_t>(fullRows.size());
+            event.stackHeight = static_cast<uint8_t>(
+                getStackHeight(gameState.playingFieldMatrixBits));
+            event.scoreDelta = gameState.score - previousScore;
+            recordPlacement(*gameState.telemetryStream, event);
+        }
+        gameState.framesSincePlace = 0;
+
+        return;
+    }
+
+    if (inputState.downArrowDown) {
+        if (!gameState.isCollisionDown) {
+            gameState.yPos += 1;
+        }
+        if (gameState.isCollisionDown) {
+            gameState.placeBlock = true;
+        }
+    }
+
+    gameState.fallSpeedAcc += gameState.fallSpeed;
+    gameState.rotationSpeedAcc += gameState.rotationSpeed;
+
+    if (gameState.rotationSpeedAcc >= 1.0) {
+        gameState.rotationSpeedAcc = 0;
+        gameState.canRotate = true;
+    }
+
+    if (gameState.fallSpeedAcc >= 1.0) {
+        if (gameState.isCollisionDown) {
+            gameState.placeBlock = true;
+        } else {
+            gameState.yPos += 1;
+            gameState.fallSpeedAcc = 0;
+        }
+    }
+}
@@ -1,4 +1,14 @@
+#pragma once
+
+#include <array>
 #include <bitset>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "spsc_queue.h"
+
+struct TelemetryStream;
 
 constexpr int MATRIX_BITS_SIZE = 160;
 constexpr int WINDOW_WIDTH = 800;
@@ -10,55 +20,201 @@ constexpr int BLOCK_SIZE_PX = 30;
 constexpr int PART_SIZE = 4;
 constexpr int SHIFT_SIZE = 16;
 
-const std::bitset<16> I_TETROID[4] = {
-    0b0000111100000000,
-    0b0010001000100010,
-    0b0000000011110000,
-    0b0100010001000100,
+using ShapeBits = std::bitset<16>;
+using MatrixBits = std::bitset<MATRIX_BITS_SIZE>;
+// One mask per board row, bit x is column x
+using RowMasks = std::array<uint16_t, BOARD_HEIGHT>;
+
+enum BlockType {
+    I,
+    J,
+    L,
+    O,
+    S,
+    T,
+    Z,
+};
+
+// Shape bits for every block and rotation, bit r * 4 + c is row r column c.
+// Rotation index + 1 is a clockwise turn.
+constexpr uint16_t TETROID_SHAPES[7][4] = {
+    {
+        0b0000111100000000,
+        0b0010001000100010,
+        0b0000000011110000,
+        0b0100010001000100,
+    },
+    {
+        0b0000010001110000,
+        0b0000001100100010,
+        0b0000000001110001,
+        0b0000001000100110,
+    },
+    {
+        0b0000000101110000,
+        0b0000001000100011,
+        0b0000000001110100,
+        0b0000011000100010,
+    },
+    {
+        0b0000000001100110,
+        0b0000000001100110,
+        0b0000000001100110,
+        0b0000000001100110,
+    },
+    {
+        0b0000001101100000,
+        0b0000001000110001,
+        0b0000000000110110,
+        0b0000010001100010,
+    },
+    {
+        0b0000001001110000,
+        0b0000001000110010,
+        0b0000000001110010,
+        0b0000001001100010,
+    },
+    {
+        0b0000011000110000,
+        0b0000000100110010,
+        0b0000000001100011,
+        0b0000001001100100,
+    },
 };
 
-const std::bitset<16> J_TETROID[4] = {
-    0b0000010001110000,
-    0b0000001100100010,
-    0b0000000001110001,
-    0b0000001000100110,
+extern const ShapeBits I_TETROID[4];
+extern const ShapeBits J_TETROID[4];
+extern const ShapeBits L_TETROID[4];
+extern const ShapeBits O_TETROID[4];
+extern const ShapeBits S_TETROID[4];
+extern const ShapeBits T_TETROID[4];
+extern const ShapeBits Z_TETROID[4];
+
+extern const ShapeBits* availableBlocks[7];
+extern const ShapeBits* currentBlockBitmap[4];
+
+enum RotationDirection {
+    ROTATE_CLOCKWISE,
+    ROTATE_COUNTER_CLOCKWISE,
+    ROTATE_180,
+    ROTATION_DIRECTION_COUNT,
 };
 
-const std::bitset<16> L_TETROID[4] = {
-    0b0000000101110000,
-    0b0000001000100011,
-    0b0000000001110100,
-    0b0000011000100010,
+// Rotation index steps for each RotationDirection
+constexpr int ROTATION_STEPS[ROTATION_DIRECTION_COUNT] = {1, 3, 2};
+
+constexpr int MAX_WALL_KICK_TESTS = 6;
+
+// Position change for one rotation test, y grows down like the board
+struct KickOffset {
+    int x;
+    int y;
+};
+
+// Offsets tried in order when rotating, the first one is always {0, 0}
+struct WallKicks {
+    KickOffset offsets[MAX_WALL_KICK_TESTS];
+    int count;
 };
 
-const std::bitset<16> O_TETROID[4] = {
-    0b0000000001100110,
-    0b0000000001100110,
-    0b0000000001100110,
-    0b0000000001100110,
+struct WallKickTables {
+    // Indexed [blockIndex][rotationIndex][RotationDirection]
+    WallKicks kicks[7][4][ROTATION_DIRECTION_COUNT];
 };
 
-const std::bitset<16> S_TETROID[4] = {
-    0b0000001101100000,
-    0b0000001000110001,
-    0b0000000000110110,
-    0b0000010001100010,
+// SRS offset data for the states 0, R, 2 and L with y growing up. A kick is
+// the offset of the state rotated from minus the offset of the state rotated
+// to, relative to the first test.
+constexpr KickOffset SRS_JLSTZ_OFFSETS[4][5] = {
+    {{0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}},
+    {{0, 0}, {1, 0}, {1, -1}, {0, 2}, {1, 2}},
+    {{0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}},
+    {{0, 0}, {-1, 0}, {-1, -1}, {0, 2}, {-1, 2}},
 };
 
-const std::bitset<16> T_TETROID[4] = {
-    0b0000001001110000,
-    0b0000001000110010,
-    0b0000000001110010,
-    0b0000001001100010,
+constexpr KickOffset SRS_I_OFFSETS[4][5] = {
+    {{0, 0}, {-1, 0}, {2, 0}, {-1, 0}, {2, 0}},
+    {{-1, 0}, {0, 0}, {0, 0}, {0, 1}, {0, -2}},
+    {{-1, 1}, {1, 1}, {-2, 1}, {1, 0}, {-2, 0}},
+    {{0, 1}, {0, 1}, {0, 1}, {0, -1}, {0, 2}},
 };
 
-const std::bitset<16> Z_TETROID[4] = {
-    0b0000011000110000,
-    0b0000000100110010,
-    0b0000000001100011,
-    0b0000001001100100,
+// SRS has no 180 degree rotation, these are the SRS+ kicks from each state
+// with y growing up
+constexpr KickOffset SRS_180_KICKS[4][6] = {
+    {{0, 0}, {0, 1}, {1, 1}, {-1, 1}, {1, 0}, {-1, 0}},
+    {{0, 0}, {1, 0}, {1, 2}, {1, 1}, {0, 2}, {0, 1}},
+    {{0, 0}, {0, -1}, {-1, -1}, {1, -1}, {-1, 0}, {1, 0}},
+    {{0, 0}, {-1, 0}, {-1, 2}, {-1, 1}, {0, 2}, {0, 1}},
 };
 
+// The shapes use the SRS bounding boxes, but rotation index 0 is the SRS
+// state 2 (flat side up, spawned upside down)
+constexpr int SRS_STATE_OF_FIRST_ROTATION = 2;
+
+constexpr bool isRotationInvariant(int blockIndex) {
+    for (int rotationIndex = 1; rotationIndex < 4; rotationIndex++) {
+        if (TETROID_SHAPES[blockIndex][rotationIndex] !=
+            TETROID_SHAPES[blockIndex][0]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+constexpr bool hasFullShapeRow(int blockIndex) {
+    for (int y = 0; y < 4; y++) {
+        if (((TETROID_SHAPES[blockIndex][0] >> (y * PART_SIZE)) & 0xF) == 0xF) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Picks the kick data for every block from its shapes: blocks that look the
+// same in every rotation never kick, blocks four cells wide use the I data
+constexpr WallKickTables generateWallKickTables() {
+    WallKickTables tables{};
+    for (int blockIndex = 0; blockIndex < 7; blockIndex++) {
+        bool rotationInvariant = isRotationInvariant(blockIndex);
+        const KickOffset(*srsOffsets)[5] =
+            hasFullShapeRow(blockIndex) ? SRS_I_OFFSETS : SRS_JLSTZ_OFFSETS;
+
+        for (int rotationIndex = 0; rotationIndex < 4; rotationIndex++) {
+            for (int direction = 0; direction < ROTATION_DIRECTION_COUNT;
+                 direction++) {
+                WallKicks& wallKicks =
+                    tables.kicks[blockIndex][rotationIndex][direction];
+                int from = (rotationIndex + SRS_STATE_OF_FIRST_ROTATION) & 0b11;
+                int to = (from + ROTATION_STEPS[direction]) & 0b11;
+
+                if (rotationInvariant) {
+                    wallKicks.offsets[0] = {0, 0};
+                    wallKicks.count = 1;
+                } else if (direction == ROTATE_180) {
+                    for (int i = 0; i < 6; i++) {
+                        wallKicks.offsets[i] = {SRS_180_KICKS[from][i].x,
+                                                -SRS_180_KICKS[from][i].y};
+                    }
+                    wallKicks.count = 6;
+                } else {
+                    for (int i = 0; i < 5; i++) {
+                        int x = (srsOffsets[from][i].x - srsOffsets[to][i].x) -
+                                (srsOffsets[from][0].x - srsOffsets[to][0].x);
+                        int y = (srsOffsets[from][i].y - srsOffsets[to][i].y) -
+                                (srsOffsets[from][0].y - srsOffsets[to][0].y);
+                        wallKicks.offsets[i] = {x, -y};
+                    }
+                    wallKicks.count = 5;
+                }
+            }
+        }
+    }
+    return tables;
+}
+
+constexpr WallKickTables WALL_KICK_TABLES = generateWallKickTables();
+
 struct Rectangle {
     int x, y;
     int w, h;
@@ -86,6 +242,8 @@ struct InputState {
     bool rightArrowDown = false;
     bool upArrowDown = false;
     bool downArrowDown = false;
+    bool counterClockwiseDown = false;
+    bool rotate180Down = false;
 };
 
 struct TetroidMatrixBits {
@@ -98,13 +256,79 @@ struct TetroidMatrixBits {
     std::bitset<MATRIX_BITS_SIZE> ZMatrixBits;
 };
 
-enum BlockType {
-    I,
-    J,
-    L,
-    O,
-    S,
-    T,
-    Z,
+enum GameEvent {
+    EVENT_MOVE,
+    EVENT_ROTATE,
+    EVENT_LOCK,
+    EVENT_LINE_CLEAR,
+    EVENT_COUNT,
+};
+
+constexpr size_t GAME_EVENT_QUEUE_SIZE = 64;
+
+// Filled by updateGameState on the thread running the game, drained by the
+// audio thread
+using GameEventQueue = SpscQueue<GameEvent, GAME_EVENT_QUEUE_SIZE>;
+
+struct GameState {
+    bool running = true;
+    bool gameOver = false;
+    int score = 0;
+    int nextBlockIndex = 0;
+    uint8_t rotationIndex = 0;
+    ShapeBits shapeBits;
+    MatrixBits matrixBits;
+    MatrixBits playingFieldMatrixBits;
+    TetroidMatrixBits tetroidMatrixBits;
+
+    bool isCollisionDown = false;
+    bool placeBlock = false;
+    int xPos = 0;
+    int yPos = 0;
+    float fallSpeed = 0.02;
+    float fallSpeedAcc = 0.0;
+
+    float rotationSpeed = 0.2;
+    float rotationSpeedAcc = 0.0;
+    bool canRotate = true;
+
+    int framesSincePlace = 0;
+    // Receives a PlacementEvent for every locked block when set
+    TelemetryStream* telemetryStream = nullptr;
+    // Receives move, rotate, lock and line clear events when set
+    GameEventQueue* eventQueue = nullptr;
 };
 
+void clearInputs(InputState& inputState);
+MatrixBits convertShapeToMatrixBits(ShapeBits block, int xPos, int yPos);
+bool isCollision(ShapeBits shapeBits,
+                 MatrixBits playingFieldMatrixBits,
+                 int xPos,
+                 int yPos);
+RowMasks convertMatrixBitsToRowMasks(const MatrixBits& matrixBits);
+bool isCollision(ShapeBits shapeBits,
+                 const RowMasks& rowMasks,
+                 int xPos,
+                 int yPos);
+void setRotationData(int blockIndex,
+                     const MatrixBits& playingFieldMatrixBits,
+                     int& xPos,
+                     int& yPos,
+                     uint8_t& rotationIndex,
+                     RotationDirection direction);
+void setRotationData(int blockIndex,
+                     const RowMasks& rowMasks,
+                     int& xPos,
+                     int& yPos,
+                     uint8_t& rotationIndex,
+                     RotationDirection direction);
+int getStackHeight(const MatrixBits& playingFieldMatrixBits);
+void checkForFullRows(MatrixBits playingFieldMatrixBits,
+                      std::vector<int>& fullRows);
+void removeAndShiftRows(MatrixBits& playingFieldMatrixBits,
+                        std::vector<int>& fullRows);
+void setCurrentBlockBitmap(int nextBlockIndex);
+int getCurrentBlockIndex();
+void seedBlockGenerator(uint32_t seed);
+void setNextBlockIndex(int& nextBlockIndex);
+void updateGameState(GameState& gameState, InputState& inputState);
@@ -9,364 +9,203 @@
 
 #include <sys/types.h>
 #include <bitset>
+#include <chrono>
 #include <cstdint>
 #include <cstdlib>
+#include <fstream>
 #include <iostream>
 #include <ostream>
-#include <random>
-#include <utility>
-#include <vector>
+#include <sstream>
+#include <string>
 
-#include "game.h"
-
-const std::bitset<16>* availableBlocks[] = {
-    I_TETROID, J_TETROID, L_TETROID, O_TETROID, S_TETROID, T_TETROID, Z_TETROID,
-};
+#ifdef __linux__
+#include <time.h>
+#include <unistd.h>
+#endif
 
-using ShapeBits = std::bitset<16>;
-using MatrixBits = std::bitset<160>;
+#include "audio.h"
+#include "font_data.h"
+#include "game.h"
+#include "telemetry.h"
+
+// Captured during static initialisation, after the shared libraries and
+// their constructors have already been loaded
+const auto STATIC_INIT_TIME = std::chrono::steady_clock::now();
+
+// Milliseconds since the kernel started this process, or a negative value
+// when that is not known. The start time only has clock tick resolution,
+// usually 10 ms.
+double getMillisecondsSinceProcessStart() {
+#ifdef __linux__
+    std::ifstream statFile("/proc/self/stat");
+    std::string stat;
+    if (!std::getline(statFile, stat)) {
+        return -1.0;
+    }
 
-const std::bitset<16>* currentBlockBitmap[4];
-const std::bitset<16>* nextBlockBitmap[4];
+    // The command name may contain spaces, count fields from after it
+    size_t nameEnd = stat.rfind(')');
+    if (nameEnd == std::string::npos) {
+        return -1.0;
+    }
 
-struct TextureState {
-    SDL_Texture* textureX = NULL;
-    SDL_Texture* textureO = NULL;
-    SDL_Texture* textureEmpty = NULL;
-    SDL_Texture* currenTexture = NULL;
-};
+    // Field 3 is the first one after the name, the start time is field 22
+    std::istringstream fields(stat.substr(nameEnd + 1));
+    std::string field;
+    for (int i = 3; i <= 22; i++) {
+        if (!(fields >> field)) {
+            return -1.0;
+        }
+    }
 
-struct GameState {
-    bool running = true;
-    bool gameOver = false;
-    int score = 0;
-    int nextBlockIndex = 0;
-    uint8_t rotationIndex = 0;
-    ShapeBits shapeBits;
-    MatrixBits matrixBits;
-    MatrixBits playingFieldMatrixBits;
-    TetroidMatrixBits tetroidMatrixBits;
-
-    bool isCollisionDown = false;
-    bool placeBlock = false;
-    int xPos = 0;
-    int yPos = 0;
-    float fallSpeed = 0.02;
-    float fallSpeedAcc = 0.0;
-
-    float rotationSpeed = 0.2;
-    float rotationSpeedAcc = 0.0;
-    bool canRotate = true;
-};
+    unsigned long long startTicks = std::strtoull(field.c_str(), NULL, 10);
+    long ticksPerSecond = sysconf(_SC_CLK_TCK);
+    timespec now;
+    if (ticksPerSecond <= 0 || clock_gettime(CLOCK_BOOTTIME, &now) != 0) {
+        return -1.0;
+    }
 
-void clearInputs(InputState& inputState) {
-    inputState.rightArrowDown = false;
-    inputState.leftArrowDown = false;
-    inputState.downArrowDown = false;
-    inputState.upArrowDown = false;
+    double nowMilliseconds = now.tv_sec * 1000.0 + now.tv_nsec / 1e6;
+    return nowMilliseconds - startTicks * 1000.0 / ticksPerSecond;
+#else
+    return -1.0;
+#endif
 }
 
-MatrixBits convertShapeToMatrixBits(std::bitset<16> block, int xPos, int yPos) {
-    std::bitset<160> board;
-    std::bitset<PART_SIZE> parts[4];
-
-    parts[0] = (block >> (SHIFT_SIZE - PART_SIZE)).to_ulong();
-    parts[1] = (block >> (SHIFT_SIZE - PART_SIZE * 2)).to_ulong();
-    parts[2] = (block >> (SHIFT_SIZE - PART_SIZE * 3)).to_ulong();
-    parts[3] = (block >> (SHIFT_SIZE - PART_SIZE * 4)).to_ulong();
-
-    board |= std::bitset<160>(parts[0].to_ullong()) << (30);
-    board |= std::bitset<160>(parts[1].to_ullong()) << (20);
-    board |= std::bitset<160>(parts[2].to_ullong()) << (10);
-    board |= std::bitset<160>(parts[3].to_ullong());
+const std::bitset<16>* nextBlockBitmap[4];
 
-    int shiftSize = (xPos + (yPos * 10));
-    if (shiftSize <= 0) {
-        return (board >> abs(shiftSize));
+// Hands the game's telemetry stream to the writer, which drains and deletes
+// it on its own thread
+void releaseTelemetryStream(TelemetryWriter& telemetryWriter,
+                            GameState& gameState) {
+    if (gameState.telemetryStream) {
+        telemetryWriter.releaseStream(gameState.telemetryStream);
+        gameState.telemetryStream = nullptr;
     }
-
-    return (board << (xPos + (yPos * 10)));
 }
 
-bool isCollision(ShapeBits shapeBits,
-                 MatrixBits playingFieldMatrixBits,
-                 int xPos,
-                 int yPos) {
-    MatrixBits matrixBits = convertShapeToMatrixBits(shapeBits, xPos, yPos);
+// Every game gets its own stream, so gameId tells the games in a file apart
+void startTelemetryGame(TelemetryWriter& telemetryWriter,
+                        GameState& gameState,
+                        uint32_t gameId) {
+    releaseTelemetryStream(telemetryWriter, gameState);
 
-    for (int y = 0; y < 4; y++) {
-        for (int x = 0; x < 4; x++) {
-            if (shapeBits.test(y * 4 + x)) {
-                if ((xPos + x) >= 10) {
-                    return true;
-                }
-
-                if ((xPos + x) < 0) {
-                    return true;
-                }
-
-                if ((yPos + y) >= 16) {
-                    return true;
-                }
-            }
-        }
-    }
-    return (matrixBits & playingFieldMatrixBits).any();
+    TelemetryStream* telemetryStream = new TelemetryStream();
+    telemetryStream->gameId = gameId;
+    telemetryWriter.addStream(*telemetryStream);
+    gameState.telemetryStream = telemetryStream;
 }
 
-std::vector<std::pair<int, int>> WALL_KICK_OFFSETS{{1, 0},   {2, 0},   {-1, 0},
-                                                   {-2, 0},  {0, -1},  {0, -2},
-                                                   {-1, -1}, {-1, -2}, {1, -2}};
-
-void setRotationData(MatrixBits playingFieldMatrixBits,
-                     int& xPos,
-                     int& yPos,
-                     uint8_t& rotationIndex) {
-    uint8_t newRotationIndex = (rotationIndex + 1) & 0b11;
-    ShapeBits shapeBits = *currentBlockBitmap[newRotationIndex];
+struct TextureState {
+    SDL_Texture* textureX = NULL;
+    SDL_Texture* textureO = NULL;
+    SDL_Texture* textureEmpty = NULL;
+    SDL_Texture* currenTexture = NULL;
 
-    bool hasCollision =
-        isCollision(shapeBits, playingFieldMatrixBits, xPos, yPos);
+    // HUD glyphs, rendered once at startup instead of every frame
+    SDL_Texture* scoreLabelTexture = NULL;
+    SDL_Texture* digitTextures[10] = {NULL};
+};
 
-    if (!isCollision(shapeBits, playingFieldMatrixBits, xPos, yPos)) {
-        rotationIndex = newRotationIndex;
-        return;
-    }
 
-    for (const auto& offset : WALL_KICK_OFFSETS) {
-        int newXPos = xPos + offset.first;
-        int newYPos = yPos + offset.second;
-        if (!isCollision(shapeBits, playingFieldMatrixBits, newXPos, newYPos)) {
-            xPos = newXPos;
-            yPos = newYPos;
-            rotationIndex = newRotationIndex;
-            return;
-        }
+SDL_Texture* SDLBakeText(SDL_Renderer* renderer,
+                         TTF_Font* font,
+                         const char* text) {
+    SDL_Color textColor = {255, 255, 255, 255};
+    SDL_Surface* textSurface = TTF_RenderText_Solid(font, text, textColor);
+    if (!textSurface) {
+        SDL_Log("Failed to render text: %s", TTF_GetError());
+        return NULL;
     }
 
-    return;
+    SDL_Texture* textTexture =
+        SDL_CreateTextureFromSurface(renderer, textSurface);
+    SDL_FreeSurface(textSurface);
+    return textTexture;
 }
 
-void checkForFullRows(MatrixBits playingFieldMatrixBits,
-                      std::vector<int>& fullRows) {
-    for (int y = 0; y < 16; y++) {
-        bool hasFullRow = true;
-        for (int x = 0; x < 10; x++) {
-            int i = y * BOARD_WIDTH + x;
-            if (!playingFieldMatrixBits.test(i)) {
-                hasFullRow = false;
-            }
-        }
+void SDLBakeHudGlyphs(SDL_Renderer* renderer,
+                      TTF_Font* font,
+                      TextureState& textureState) {
+    textureState.scoreLabelTexture = SDLBakeText(renderer, font, "Score: ");
 
-        if (hasFullRow) {
-            fullRows.push_back(y);
-        }
+    for (int digit = 0; digit < 10; digit++) {
+        char digitStr[2] = {static_cast<char>('0' + digit), '\0'};
+        textureState.digitTextures[digit] =
+            SDLBakeText(renderer, font, digitStr);
     }
 }
 
-void removeAndShiftRows(MatrixBits& playingFieldMatrixBits,
-                        std::vector<int>& fullRows) {
-    if (fullRows.size() <= 0) {
-        return;
-    }
-    for (const auto& fullRow : fullRows) {
-        for (int i = fullRow * 10; i < (fullRow * 10) + 10; i++) {
-            playingFieldMatrixBits.reset(i);
-        }
-
-        MatrixBits tempPlayingFieldMatrixBits;
-        tempPlayingFieldMatrixBits = playingFieldMatrixBits;
-
-        tempPlayingFieldMatrixBits <<= (160 - fullRow * 10);
-        tempPlayingFieldMatrixBits >>= (160 - fullRow * 10);
-        tempPlayingFieldMatrixBits <<= 10;
-
-        playingFieldMatrixBits >>= ((fullRow) * 10);
-        playingFieldMatrixBits <<= ((fullRow) * 10);
-        playingFieldMatrixBits |= tempPlayingFieldMatrixBits;
+bool SDLInitialiseGame(SDL_Window*& window,
+                       SDL_Renderer*& renderer,
+                       TextureState& textureState) {
+    // Load assets before the window exists, the font is embedded in the
+    // binary so this does not touch the filesystem
+    if (TTF_Init() != 0) {
+        SDL_Log("Failed to initialise SDL_ttf: %s", TTF_GetError());
+        return false;
     }
-}
 
-void setCurrentBlockBitmap(int nextBlockIndex) {
-    const std::bitset<16>* shapeBits = availableBlocks[nextBlockIndex];
-    currentBlockBitmap[0] = &shapeBits[0];
-    currentBlockBitmap[1] = &shapeBits[1];
-    currentBlockBitmap[2] = &shapeBits[2];
-    currentBlockBitmap[3] = &shapeBits[3];
-}
-
-void setNextBlockIndex(int& nextBlockIndex) {
-    // Generate random number
-    static std::mt19937 rng(time(nullptr));
-    static std::uniform_int_distribution<int> dist(0, 6);  // 0 or 1
-    nextBlockIndex = dist(rng);
-}
+    TTF_Font* font = TTF_OpenFontRW(
+        SDL_RWFromConstMem(FONT_DATA, FONT_DATA_SIZE), 1, 20);
 
-void updateGameState(GameState& gameState, InputState& inputState) {
-    if(gameState.gameOver) {
-        if(inputState.rightArrowDown) {
-            gameState = *new GameState();
-        }
-        return;
+    if (!font) {
+        SDL_Log("Failed to load font: %s", TTF_GetError());
     }
 
-    gameState.shapeBits = *currentBlockBitmap[gameState.rotationIndex];
-    gameState.matrixBits = convertShapeToMatrixBits(
-        gameState.shapeBits, gameState.xPos, gameState.yPos);
-
-    gameState.isCollisionDown =
-        isCollision(gameState.shapeBits, gameState.playingFieldMatrixBits,
-                    gameState.xPos, gameState.yPos + 1);
-
-    if (inputState.leftArrowDown) {
-        if (!isCollision(gameState.shapeBits, gameState.playingFieldMatrixBits,
-                         gameState.xPos - 1, gameState.yPos)) {
-            gameState.xPos -= 1;
+    // Only video is needed up front, other subsystems are started on demand
+    if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+        SDL_Log("Failed to initialise SDL: %s", SDL_GetError());
+        if (font) {
+            TTF_CloseFont(font);
         }
+        return false;
     }
 
-    if (inputState.rightArrowDown) {
-        if (!isCollision(gameState.shapeBits, gameState.playingFieldMatrixBits,
-                         gameState.xPos + 1, gameState.yPos)) {
-            gameState.xPos += 1;
+    window = SDL_CreateWindow("Title", SDL_WINDOWPOS_CENTERED,
+                              SDL_WINDOWPOS_CENTERED, WINDOW_WIDTH,
+                              WINDOW_HEIGHT, 0);
+    if (!window) {
+        SDL_Log("Failed to create window: %s", SDL_GetError());
+        if (font) {
+            TTF_CloseFont(font);
         }
+        return false;
     }
 
-    if (inputState.upArrowDown && gameState.canRotate) {
-        setRotationData(gameState.playingFieldMatrixBits, gameState.xPos,
-                        gameState.yPos, gameState.rotationIndex);
-        gameState.canRotate = false;
+    // Prefer any driver, then fall back to the software renderer
+    renderer = SDL_CreateRenderer(window, -1, 0);
+    if (!renderer) {
+        renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_SOFTWARE);
     }
 
-    if (gameState.isCollisionDown && gameState.placeBlock) {
-        if (currentBlockBitmap[0] == &I_TETROID[0]) {
-            gameState.tetroidMatrixBits.IMatrixBits |= gameState.matrixBits;
-        }
-
-        if (currentBlockBitmap[0] == &J_TETROID[0]) {
-            gameState.tetroidMatrixBits.JMatrixBits |= gameState.matrixBits;
-        }
-
-        if (currentBlockBitmap[0] == &L_TETROID[0]) {
-            gameState.tetroidMatrixBits.LMatrixBits |= gameState.matrixBits;
+    if (!renderer) {
+        SDL_Log("Failed to create renderer: %s", SDL_GetError());
+        if (font) {
+            TTF_CloseFont(font);
         }
-
-        if (currentBlockBitmap[0] == &O_TETROID[0]) {
-            gameState.tetroidMatrixBits.OMatrixBits |= gameState.matrixBits;
-        }
-
-        if (currentBlockBitmap[0] == &S_TETROID[0]) {
-            gameState.tetroidMatrixBits.SMatrixBits |= gameState.matrixBits;
-        }
-
-        if (currentBlockBitmap[0] == &T_TETROID[0]) {
-            gameState.tetroidMatrixBits.TMatrixBits |= gameState.matrixBits;
-        }
-
-        if (currentBlockBitmap[0] == &Z_TETROID[0]) {
-            gameState.tetroidMatrixBits.ZMatrixBits |= gameState.matrixBits;
-        }
-
-        gameState.playingFieldMatrixBits |=
-            gameState.tetroidMatrixBits.IMatrixBits |
-            gameState.tetroidMatrixBits.JMatrixBits |
-            gameState.tetroidMatrixBits.LMatrixBits |
-            gameState.tetroidMatrixBits.OMatrixBits |
-            gameState.tetroidMatrixBits.SMatrixBits |
-            gameState.tetroidMatrixBits.TMatrixBits |
-            gameState.tetroidMatrixBits.ZMatrixBits;
-
-        gameState.isCollisionDown = false;
-        gameState.placeBlock = false;
-        gameState.yPos = 0;
-        gameState.xPos = 5;
-        gameState.rotationIndex = 0;
-
-        setCurrentBlockBitmap(gameState.nextBlockIndex);
-
-        setNextBlockIndex(gameState.nextBlockIndex);
-
-        ShapeBits shapeBits = *currentBlockBitmap[gameState.rotationIndex];
-        MatrixBits matrixBits = convertShapeToMatrixBits(
-            shapeBits, gameState.xPos, gameState.yPos);
-
-        if((matrixBits & gameState.playingFieldMatrixBits).any()) {
-            gameState.gameOver = true;
-        }
-
-        std::vector<int> fullRows;
-        checkForFullRows(gameState.playingFieldMatrixBits, fullRows);
-        if(fullRows.size() > 0) {
-            removeAndShiftRows(gameState.tetroidMatrixBits.IMatrixBits, fullRows);
-            removeAndShiftRows(gameState.tetroidMatrixBits.JMatrixBits, fullRows);
-            removeAndShiftRows(gameState.tetroidMatrixBits.LMatrixBits, fullRows);
-            removeAndShiftRows(gameState.tetroidMatrixBits.OMatrixBits, fullRows);
-            removeAndShiftRows(gameState.tetroidMatrixBits.SMatrixBits, fullRows);
-            removeAndShiftRows(gameState.tetroidMatrixBits.TMatrixBits, fullRows);
-            removeAndShiftRows(gameState.tetroidMatrixBits.ZMatrixBits, fullRows);
-
-            gameState.playingFieldMatrixBits =
-                gameState.tetroidMatrixBits.IMatrixBits |
-                gameState.tetroidMatrixBits.JMatrixBits |
-                gameState.tetroidMatrixBits.LMatrixBits |
-                gameState.tetroidMatrixBits.OMatrixBits |
-                gameState.tetroidMatrixBits.SMatrixBits |
-                gameState.tetroidMatrixBits.TMatrixBits |
-                gameState.tetroidMatrixBits.ZMatrixBits;
-
-            // Update score
-            gameState.score += (fullRows.size() * 100);
-            gameState.fallSpeed += 0.01;
-
-        }
-
-        return;
+        return false;
     }
 
-    if (inputState.downArrowDown) {
-        if (!gameState.isCollisionDown) {
-            gameState.yPos += 1;
-        }
-        if (gameState.isCollisionDown) {
-            gameState.placeBlock = true;
-        }
+    if (font) {
+        SDLBakeHudGlyphs(renderer, font, textureState);
+        TTF_CloseFont(font);
     }
+    return true;
+}
 
-    gameState.fallSpeedAcc += gameState.fallSpeed;
-    gameState.rotationSpeedAcc += gameState.rotationSpeed;
-
-    if (gameState.rotationSpeedAcc >= 1.0) {
-        gameState.rotationSpeedAcc = 0;
-        gameState.canRotate = true;
+void SDLDestroyTextures(TextureState& textureState) {
+    if (textureState.scoreLabelTexture) {
+        SDL_DestroyTexture(textureState.scoreLabelTexture);
     }
 
-    if (gameState.fallSpeedAcc >= 1.0) {
-        if (gameState.isCollisionDown) {
-            gameState.placeBlock = true;
-        } else {
-            gameState.yPos += 1;
-            gameState.fallSpeedAcc = 0;
+    for (int digit = 0; digit < 10; digit++) {
+        if (textureState.digitTextures[digit]) {
+            SDL_DestroyTexture(textureState.digitTextures[digit]);
         }
     }
 }
 
-void SDLInitialiseGame(SDL_Window*& window,
-                       SDL_Renderer*& renderer,
-                       TTF_Font*& font) {
-    SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO);
-    TTF_Init();
-    window = SDL_CreateWindow("Title", SDL_WINDOWPOS_CENTERED,
-                              SDL_WINDOWPOS_CENTERED, WINDOW_WIDTH,
-                              WINDOW_HEIGHT, 0);
-    renderer = SDL_CreateRenderer(window, 0, 0);
-
-    font = TTF_OpenFont("../AdwaitaSans-Regular.ttf", 20);
-
-    if (!font) {
-        SDL_Log("Failed to load font: %s", TTF_GetError());
-    }
-}
-
 void SDLHandleEvent(SDL_Event& event, InputState& inputState) {
     while (SDL_PollEvent(&event)) {
         switch (event.type) {
@@ -384,6 +223,12 @@ void SDLHandleEvent(SDL_Event& event, InputState& inputState) {
                     case SDLK_RIGHT:
                         inputState.rightArrowDown = true;
                         break;
+                    case SDLK_z:
+                        inputState.counterClockwiseDown = true;
+                        break;
+                    case SDLK_a:
+                        inputState.rotate180Down = true;
+                        break;
                     default:
                         break;
                 }
@@ -434,26 +279,36 @@ void SDLRenderBlock(BlockType blockType, SDL_Renderer* renderer) {
     }
 }
 
-void SDLRenderScore(SDL_Renderer* renderer, TTF_Font* font, int score) {
-    SDL_Color textColor = {255, 255, 255, 255};
-    std::string scoreStr = "Score: " + std::to_string(score);
-    SDL_Surface* textSurface =
-        TTF_RenderText_Solid(font, scoreStr.c_str(), textColor);
-
-    SDL_Texture* textTexture =
-        SDL_CreateTextureFromSurface(renderer, textSurface);
-    SDL_FreeSurface(textSurface);
+void SDLRenderGlyph(SDL_Renderer* renderer, SDL_Texture* texture, int& x) {
+    if (!texture) {
+        return;
+    }
 
     SDL_Rect textRect;
-    textRect.x = 360;
+    textRect.x = x;
     textRect.y = 200;
-    textRect.w = textSurface->w;
-    textRect.h = textSurface->h;
-    SDL_RenderCopy(renderer, textTexture, NULL, &textRect);
+    SDL_QueryTexture(texture, NULL, NULL, &textRect.w, &textRect.h);
+    SDL_RenderCopy(renderer, texture, NULL, &textRect);
+
+    x += textRect.w;
+}
+
+void SDLRenderScore(SDL_Renderer* renderer,
+                    TextureState& textureState,
+                    int score) {
+    std::string scoreStr = std::to_string(score);
+
+    int x = 360;
+    SDLRenderGlyph(renderer, textureState.scoreLabelTexture, x);
+    for (const char& digit : scoreStr) {
+        if (digit < '0' || digit > '9') {
+            continue;
+        }
+        SDLRenderGlyph(renderer, textureState.digitTextures[digit - '0'], x);
+    }
 }
 
 void SDLRenderToScreen(SDL_Renderer* renderer,
-                       TTF_Font* font,
                        GameState& gameState,
                        TextureState& textureState) {
     SDL_SetRenderDrawColor(renderer, 5, 0, 5, 255);
@@ -475,7 +330,7 @@ void SDLRenderToScreen(SDL_Renderer* renderer,
     nextBlockBitmap[0] = &nextBlockBits[0];
     nextBlockBitmap[1] = &nextBlockBits[1];
 
-    SDLRenderScore(renderer, font, gameState.score);
+    SDLRenderScore(renderer, textureState, gameState.score);
 
     bool nextIsIBlock = nextBlockBitmap[0] == &I_TETROID[0];
     bool nextIsJBlock = nextBlockBitmap[0] == &J_TETROID[0];
@@ -631,17 +486,55 @@ void SDLRenderToScreen(SDL_Renderer* renderer,
     SDL_RenderPresent(renderer);
 }
 
-int main() {
-    SDL_Window* window;
-    SDL_Renderer* renderer;
-    TTF_Font* font;
+bool hasArgument(int argc, char* argv[], const std::string& argument) {
+    for (int i = 1; i < argc; i++) {
+        if (argument == argv[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int main(int argc, char* argv[]) {
+    SDL_Window* window = NULL;
+    SDL_Renderer* renderer = NULL;
 
     SDL_Event event;
     GameState gameState;
     InputState inputState;
     TextureState textureState;
+    GameEventQueue gameEventQueue;
+    AudioState audioState;
+    TelemetryWriter telemetryWriter;
+    uint32_t telemetryGameId = 0;
+
+    bool measureStartup = hasArgument(argc, argv, "--measure-startup");
 
-    SDLInitialiseGame(window, renderer, font);
+    // A fixed seed reproduces the piece sequence, e.g. for the solver
+    for (int i = 1; i + 1 < argc; i++) {
+        if (std::string(argv[i]) == "--seed") {
+            seedBlockGenerator(std::strtoul(argv[i + 1], NULL, 10));
+        }
+
+        if (std::string(argv[i]) == "--telemetry") {
+            if (telemetryWriter.open(argv[i + 1])) {
+                startTelemetryGame(telemetryWriter, gameState, telemetryGameId);
+            } else {
+                SDL_Log("Failed to open telemetry file: %s", argv[i + 1]);
+            }
+        }
+    }
+
+    if (!SDLInitialiseGame(window, renderer, textureState)) {
+        releaseTelemetryStream(telemetryWriter, gameState);
+        telemetryWriter.close();
+        if (window) {
+            SDL_DestroyWindow(window);
+        }
+        TTF_Quit();
+        SDL_Quit();
+        return 1;
+    }
 
     setNextBlockIndex(gameState.nextBlockIndex);
     setCurrentBlockBitmap(gameState.nextBlockIndex);
@@ -670,13 +563,48 @@ int main() {
 
     while (inputState.running) {
         SDLHandleEvent(event, inputState);
+        bool wasGameOver = gameState.gameOver;
         updateGameState(gameState, inputState);
 
-        SDLRenderToScreen(renderer, font, gameState, textureState);
+        // A new game started, record it under its own id
+        if (wasGameOver && !gameState.gameOver && gameState.telemetryStream) {
+            startTelemetryGame(telemetryWriter, gameState, ++telemetryGameId);
+        }
+
+        SDLRenderToScreen(renderer, gameState, textureState);
+
+        if (measureStartup) {
+            // Time to the first presented frame
+            double startupTime = getMillisecondsSinceProcessStart();
+            std::chrono::duration<double, std::milli> staticInitTime =
+                std::chrono::steady_clock::now() - STATIC_INIT_TIME;
+            if (startupTime >= 0.0) {
+                std::cout << "Startup time: " << startupTime << " ms"
+                          << std::endl;
+            }
+            std::cout << "Time since static initialisation: "
+                      << staticInitTime.count() << " ms" << std::endl;
+            break;
+        }
+
+        // Start audio once the first frame is on screen
+        if (audioState.device == 0 && audioState.eventQueue == nullptr) {
+            if (SDLInitialiseAudio(audioState, gameEventQueue)) {
+                gameState.eventQueue = &gameEventQueue;
+            }
+        }
+
         clearInputs(inputState);
         SDL_Delay(16);
     }
 
+    releaseTelemetryStream(telemetryWriter, gameState);
+    telemetryWriter.close();
+    SDLCloseAudio(audioState);
+    SDLDestroyTextures(textureState);
+    SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
+    TTF_Quit();
+    SDL_Quit();
     return 0;
 }
@@ -0,0 +1,594 @@
+// Searches for placement sequences that perfect clear a board, or clear the
+// most lines, given the upcoming pieces.
+//
+// Usage: Solver [--pieces IJLOSTZ | --seed N] [--count N] [--board FILE]
+//               [--mode pc|lines] [--max-height N] [--threads N]
+//
+// The board file holds up to 16 rows of 10 characters, '.' is empty and
+// anything else is filled. Rows are aligned to the bottom of the playfield.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "game.h"
+
+const char BLOCK_NAMES[] = "IJLOSTZ";
+
+constexpr int SPAWN_X_POS = 5;
+constexpr int MIN_X_POS = -3;
+constexpr int MIN_Y_POS = -3;
+constexpr int X_POS_COUNT = BOARD_WIDTH - MIN_X_POS;
+constexpr int Y_POS_COUNT = BOARD_HEIGHT - MIN_Y_POS;
+constexpr int TRANSPOSITION_SHARDS = 64;
+
+enum SearchMode {
+    PERFECT_CLEAR,
+    MAX_LINES,
+};
+
+struct Placement {
+    int blockIndex;
+    uint8_t rotationIndex;
+    int xPos;
+    int yPos;
+};
+
+struct Move {
+    Placement placement;
+    MatrixBits board;
+    int linesCleared;
+};
+
+struct SearchNode {
+    MatrixBits board;
+    int lines;
+    std::vector<Placement> path;
+};
+
+struct TranspositionKey {
+    MatrixBits board;
+    int depth;
+
+    bool operator==(const TranspositionKey& other) const {
+        return depth == other.depth && board == other.board;
+    }
+};
+
+struct TranspositionKeyHash {
+    size_t operator()(const TranspositionKey& key) const {
+        return std::hash<MatrixBits>()(key.board) ^
+               (static_cast<size_t>(key.depth) * 0x9e3779b97f4a7c15ull);
+    }
+};
+
+// Remembers the most lines cleared on the way to each (board, depth). A
+// node reached again with no more lines than before cannot do any better.
+class TranspositionTable {
+   public:
+    bool shouldVisit(const MatrixBits& board, int depth, int lines) {
+        TranspositionKey key = {board, depth};
+        Shard& shard = shards[TranspositionKeyHash()(key) % TRANSPOSITION_SHARDS];
+
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto entry = shard.bestLines.find(key);
+        if (entry != shard.bestLines.end() && entry->second >= lines) {
+            return false;
+        }
+
+        shard.bestLines[key] = lines;
+        return true;
+    }
+
+   private:
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<TranspositionKey, int, TranspositionKeyHash>
+            bestLines;
+    };
+
+    Shard shards[TRANSPOSITION_SHARDS];
+};
+
+struct SearchState {
+    std::vector<int> pieces;
+    SearchMode mode = PERFECT_CLEAR;
+    MatrixBits aboveMaxHeightMask;
+
+    TranspositionTable transpositionTable;
+    std::atomic<bool> foundPerfectClear{false};
+    std::atomic<int> bestLines{-1};
+    std::atomic<long long> nodesVisited{0};
+
+    std::mutex bestMutex;
+    std::vector<Placement> bestPath;
+};
+
+// Lists every distinct resting place reachable from the spawn position by
+// moving, soft dropping and rotating with wall kicks
+void generateMoves(int blockIndex,
+                   const MatrixBits& board,
+                   const MatrixBits& aboveMaxHeightMask,
+                   std::vector<Move>& moves) {
+    const ShapeBits* blockBitmap = availableBlocks[blockIndex];
+    const RowMasks rowMasks = convertMatrixBitsToRowMasks(board);
+    bool visited[4][Y_POS_COUNT][X_POS_COUNT] = {};
+
+    if (isCollision(blockBitmap[0], rowMasks, SPAWN_X_POS, 0)) {
+        return;
+    }
+
+    std::vector<Placement> frontier;
+    frontier.push_back({blockIndex, 0, SPAWN_X_POS, 0});
+    visited[0][-MIN_Y_POS][SPAWN_X_POS - MIN_X_POS] = true;
+
+    // Every position in the empty rows above the stack is reachable, so
+    // start from just above the stack instead of walking down from spawn
+    int openYPos = BOARD_HEIGHT - getStackHeight(board) - PART_SIZE;
+    if (openYPos > 0) {
+        frontier.clear();
+        visited[0][-MIN_Y_POS][SPAWN_X_POS - MIN_X_POS] = false;
+
+        for (uint8_t rotationIndex = 0; rotationIndex < 4; rotationIndex++) {
+            for (int xPos = MIN_X_POS; xPos < BOARD_WIDTH; xPos++) {
+                if (!isCollision(blockBitmap[rotationIndex], rowMasks, xPos,
+                                 openYPos)) {
+                    frontier.push_back({blockIndex, rotationIndex, xPos,
+                                        openYPos});
+                    visited[rotationIndex][openYPos - MIN_Y_POS]
+                           [xPos - MIN_X_POS] = true;
+                }
+            }
+        }
+    }
+
+    while (!frontier.empty()) {
+        Placement current = frontier.back();
+        frontier.pop_back();
+
+        ShapeBits shapeBits = blockBitmap[current.rotationIndex];
+
+        Placement next[6] = {current, current, current,
+                             current, current, current};
+        next[0].xPos -= 1;
+        next[1].xPos += 1;
+        next[2].yPos += 1;
+        for (int direction = 0; direction < ROTATION_DIRECTION_COUNT;
+             direction++) {
+            Placement& rotated = next[3 + direction];
+            setRotationData(blockIndex, rowMasks, rotated.xPos, rotated.yPos,
+                            rotated.rotationIndex,
+                            static_cast<RotationDirection>(direction));
+        }
+
+        for (int i = 0; i < 6; i++) {
+            if (i < 3 && isCollision(shapeBits, rowMasks, next[i].xPos,
+                                     next[i].yPos)) {
+                continue;
+            }
+
+            if (next[i].xPos < MIN_X_POS || next[i].xPos >= BOARD_WIDTH ||
+                next[i].yPos < MIN_Y_POS || next[i].yPos >= BOARD_HEIGHT) {
+                continue;
+            }
+
+            bool& seen = visited[next[i].rotationIndex][next[i].yPos - MIN_Y_POS]
+                                [next[i].xPos - MIN_X_POS];
+            if (!seen) {
+                seen = true;
+                frontier.push_back(next[i]);
+            }
+        }
+
+        if (!isCollision(shapeBits, rowMasks, current.xPos,
+                         current.yPos + 1)) {
+            continue;
+        }
+
+        // Resting place, lock the block like updateGameState does
+        MatrixBits matrixBits =
+            convertShapeToMatrixBits(shapeBits, current.xPos, current.yPos);
+        if (matrixBits.count() != 4 || (matrixBits & aboveMaxHeightMask).any()) {
+            continue;
+        }
+
+        MatrixBits newBoard = board | matrixBits;
+        std::vector<int> fullRows;
+        checkForFullRows(newBoard, fullRows);
+        removeAndShiftRows(newBoard, fullRows);
+
+        bool isDuplicate = false;
+        for (const auto& move : moves) {
+            if (move.board == newBoard) {
+                isDuplicate = true;
+                break;
+            }
+        }
+
+        if (!isDuplicate) {
+            moves.push_back(
+                {current, newBoard, static_cast<int>(fullRows.size())});
+        }
+    }
+}
+
+// Filled cells in even columns minus filled cells in odd columns
+int getColumnImbalance(const MatrixBits& board) {
+    int imbalance = 0;
+    for (int i = 0; i < MATRIX_BITS_SIZE; i++) {
+        if (board.test(i)) {
+            imbalance += (i % BOARD_WIDTH) % 2 == 0 ? 1 : -1;
+        }
+    }
+    return imbalance;
+}
+
+// A perfect clear needs some number of further blocks that completes whole
+// rows covering at least the current stack, and that cancels the column
+// imbalance. Full rows are balanced and clears never move cells sideways,
+// so only the blocks change it: in steps of two cells, J and L always by
+// one, T by at most one, I by zero or two and O, S and Z never.
+bool canPerfectClear(const MatrixBits& board,
+                     const std::vector<int>& pieces,
+                     int depth) {
+    int cells = static_cast<int>(board.count());
+    int stackHeight = getStackHeight(board);
+    int imbalanceSteps = std::abs(getColumnImbalance(board)) / 2;
+
+    int fixedSteps = 0;
+    int optionalSteps = 0;
+    int doubleSteps = 0;
+    for (size_t i = depth; i < pieces.size(); i++) {
+        if (pieces[i] == J || pieces[i] == L) {
+            fixedSteps++;
+        } else if (pieces[i] == T) {
+            optionalSteps++;
+        } else if (pieces[i] == I) {
+            doubleSteps++;
+        }
+
+        int totalCells = cells + static_cast<int>(i - depth + 1) * 4;
+        if (totalCells % BOARD_WIDTH != 0 ||
+            totalCells / BOARD_WIDTH < stackHeight) {
+            continue;
+        }
+
+        int maxSteps = fixedSteps + optionalSteps + doubleSteps * 2;
+        if (imbalanceSteps > maxSteps) {
+            continue;
+        }
+
+        // Without a T the fixed steps decide whether the total is odd
+        if (optionalSteps == 0 && (imbalanceSteps + fixedSteps) % 2 != 0) {
+            continue;
+        }
+        return true;
+    }
+    return false;
+}
+
+// Upper bound on the rows the remaining blocks can complete, filling the
+// fullest rows first
+int getMaxLinesBound(const MatrixBits& board, int remainingPieces) {
+    int missingCells[BOARD_HEIGHT];
+    for (int y = 0; y < BOARD_HEIGHT; y++) {
+        missingCells[y] = BOARD_WIDTH;
+        for (int x = 0; x < BOARD_WIDTH; x++) {
+            if (board.test(y * BOARD_WIDTH + x)) {
+                missingCells[y]--;
+            }
+        }
+    }
+    std::sort(missingCells, missingCells + BOARD_HEIGHT);
+
+    int cells = remainingPieces * 4;
+    int lines = 0;
+    while (lines < BOARD_HEIGHT && missingCells[lines] <= cells) {
+        cells -= missingCells[lines];
+        lines++;
+    }
+    return lines;
+}
+
+void recordResult(SearchState& searchState,
+                  int lines,
+                  const std::vector<Placement>& path) {
+    std::lock_guard<std::mutex> lock(searchState.bestMutex);
+    if (lines <= searchState.bestLines) {
+        return;
+    }
+
+    searchState.bestLines = lines;
+    searchState.bestPath = path;
+}
+
+// Records a perfect clear or a new best line count reached at this node and
+// returns whether searching below it can still improve the result
+bool checkNode(SearchState& searchState,
+               const MatrixBits& board,
+               int lines,
+               const std::vector<Placement>& path) {
+    int depth = static_cast<int>(path.size());
+    int remainingPieces = static_cast<int>(searchState.pieces.size()) - depth;
+
+    if (searchState.mode == PERFECT_CLEAR) {
+        if (depth > 0 && board.none()) {
+            std::lock_guard<std::mutex> lock(searchState.bestMutex);
+            if (!searchState.foundPerfectClear) {
+                searchState.foundPerfectClear = true;
+                searchState.bestLines = lines;
+                searchState.bestPath = path;
+            }
+            return false;
+        }
+
+        return canPerfectClear(board, searchState.pieces, depth);
+    }
+
+    if (lines > searchState.bestLines) {
+        recordResult(searchState, lines, path);
+    }
+
+    int maxLines = lines + getMaxLinesBound(board, remainingPieces);
+    return remainingPieces > 0 && maxLines > searchState.bestLines;
+}
+
+void search(SearchState& searchState,
+            const MatrixBits& board,
+            int lines,
+            std::vector<Placement>& path) {
+    if (searchState.foundPerfectClear) {
+        return;
+    }
+    searchState.nodesVisited++;
+
+    if (!checkNode(searchState, board, lines, path)) {
+        return;
+    }
+
+    int depth = static_cast<int>(path.size());
+
+    // Lines cleared on the way make no difference to a perfect clear
+    int transpositionLines = searchState.mode == PERFECT_CLEAR ? 0 : lines;
+    if (!searchState.transpositionTable.shouldVisit(board, depth,
+                                                    transpositionLines)) {
+        return;
+    }
+
+    std::vector<Move> moves;
+    generateMoves(searchState.pieces[depth], board,
+                  searchState.aboveMaxHeightMask, moves);
+
+    // Try line clears first, they tighten the bound sooner
+    std::sort(moves.begin(), moves.end(), [](const Move& a, const Move& b) {
+        return a.linesCleared > b.linesCleared;
+    });
+
+    for (const auto& move : moves) {
+        path.push_back(move.placement);
+        search(searchState, move.board, lines + move.linesCleared, path);
+        path.pop_back();
+    }
+}
+
+void runWorker(SearchState& searchState,
+               const std::vector<SearchNode>& tasks,
+               std::atomic<size_t>& nextTask) {
+    for (size_t i = nextTask++; i < tasks.size(); i = nextTask++) {
+        std::vector<Placement> path = tasks[i].path;
+        search(searchState, tasks[i].board, tasks[i].lines, path);
+    }
+}
+
+// Expands the first levels of the tree so every thread has work. Every
+// expanded node gets the same checks as in search, so results found at
+// these depths are kept.
+std::vector<SearchNode> createTasks(SearchState& searchState,
+                                    const MatrixBits& board,
+                                    size_t minTasks) {
+    std::vector<SearchNode> tasks = {{board, 0, {}}};
+
+    while (tasks.size() < minTasks && !searchState.foundPerfectClear) {
+        std::vector<SearchNode> nextTasks;
+        for (const auto& task : tasks) {
+            if (!checkNode(searchState, task.board, task.lines, task.path)) {
+                continue;
+            }
+
+            std::vector<Move> moves;
+            generateMoves(searchState.pieces[task.path.size()], task.board,
+                          searchState.aboveMaxHeightMask, moves);
+            if (moves.empty()) {
+                nextTasks.push_back(task);
+                continue;
+            }
+
+            for (const auto& move : moves) {
+                SearchNode node = {move.board, task.lines + move.linesCleared,
+                                   task.path};
+                node.path.push_back(move.placement);
+                nextTasks.push_back(node);
+            }
+        }
+
+        if (nextTasks.size() <= tasks.size()) {
+            break;
+        }
+        tasks = nextTasks;
+    }
+
+    return tasks;
+}
+
+bool readBoard(const std::string& fileName, MatrixBits& board) {
+    std::ifstream file(fileName);
+    if (!file) {
+        return false;
+    }
+
+    std::vector<std::string> rows;
+    std::string row;
+    while (std::getline(file, row)) {
+        if (!row.empty()) {
+            rows.push_back(row);
+        }
+    }
+
+    if (rows.size() > BOARD_HEIGHT) {
+        return false;
+    }
+
+    int firstRow = BOARD_HEIGHT - static_cast<int>(rows.size());
+    for (size_t y = 0; y < rows.size(); y++) {
+        for (size_t x = 0; x < rows[y].size() && x < BOARD_WIDTH; x++) {
+            if (rows[y][x] != '.') {
+                board.set((firstRow + y) * BOARD_WIDTH + x);
+            }
+        }
+    }
+    return true;
+}
+
+void printUsage() {
+    std::cerr << "Usage: Solver [--pieces IJLOSTZ | --seed N] [--count N] "
+                 "[--board FILE] [--mode pc|lines] [--max-height N] "
+                 "[--threads N]"
+              << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    SearchState searchState;
+    MatrixBits board;
+
+    std::string pieceNames;
+    bool hasSeed = false;
+    uint32_t seed = 0;
+    int count = 10;
+    int maxHeight = -1;
+    unsigned int threadCount = std::thread::hardware_concurrency();
+
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        if (i + 1 >= argc) {
+            printUsage();
+            return 1;
+        }
+
+        std::string value = argv[++i];
+        if (argument == "--pieces") {
+            pieceNames = value;
+        } else if (argument == "--seed") {
+            hasSeed = true;
+            seed = std::strtoul(value.c_str(), NULL, 10);
+        } else if (argument == "--count") {
+            count = std::atoi(value.c_str());
+        } else if (argument == "--board") {
+            if (!readBoard(value, board)) {
+                std::cerr << "Failed to read board: " << value << std::endl;
+                return 1;
+            }
+        } else if (argument == "--mode") {
+            searchState.mode = value == "lines" ? MAX_LINES : PERFECT_CLEAR;
+        } else if (argument == "--max-height") {
+            maxHeight = std::atoi(value.c_str());
+        } else if (argument == "--threads") {
+            threadCount = std::atoi(value.c_str());
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+
+    if (hasSeed) {
+        // Same draws as the game: the first block, then one per lock
+        seedBlockGenerator(seed);
+        for (int i = 0; i < count; i++) {
+            int blockIndex;
+            setNextBlockIndex(blockIndex);
+            searchState.pieces.push_back(blockIndex);
+        }
+    }
+
+    for (const char& name : pieceNames) {
+        const char* found = std::find(BLOCK_NAMES, BLOCK_NAMES + 7, name);
+        if (found == BLOCK_NAMES + 7) {
+            std::cerr << "Unknown block: " << name << std::endl;
+            return 1;
+        }
+        searchState.pieces.push_back(static_cast<int>(found - BLOCK_NAMES));
+    }
+
+    if (searchState.pieces.empty()) {
+        printUsage();
+        return 1;
+    }
+
+    // Perfect clears stay low, limiting the stack keeps the search small
+    if (maxHeight < 0) {
+        maxHeight = searchState.mode == PERFECT_CLEAR ? 4 : BOARD_HEIGHT;
+    }
+    for (int i = 0; i < (BOARD_HEIGHT - maxHeight) * BOARD_WIDTH; i++) {
+        searchState.aboveMaxHeightMask.set(i);
+    }
+
+    threadCount = std::max(1u, threadCount);
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    std::vector<SearchNode> tasks =
+        createTasks(searchState, board, threadCount * 4);
+    std::atomic<size_t> nextTask{0};
+
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < threadCount; i++) {
+        workers.push_back(std::thread(runWorker, std::ref(searchState),
+                                      std::cref(tasks), std::ref(nextTask)));
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    std::chrono::duration<double> searchTime =
+        std::chrono::steady_clock::now() - startTime;
+
+    std::cout << "Pieces: ";
+    for (const auto& blockIndex : searchState.pieces) {
+        std::cout << BLOCK_NAMES[blockIndex];
+    }
+    std::cout << std::endl;
+
+    if (searchState.mode == PERFECT_CLEAR && !searchState.foundPerfectClear) {
+        std::cout << "No perfect clear found" << std::endl;
+    } else {
+        if (searchState.mode == PERFECT_CLEAR) {
+            std::cout << "Perfect clear";
+        } else {
+            std::cout << "Lines cleared: " << searchState.bestLines;
+        }
+        std::cout << " in " << searchState.bestPath.size() << " pieces"
+                  << std::endl;
+
+        for (size_t i = 0; i < searchState.bestPath.size(); i++) {
+            const Placement& placement = searchState.bestPath[i];
+            std::cout << i + 1 << ". " << BLOCK_NAMES[placement.blockIndex]
+                      << " rotation " << int(placement.rotationIndex)
+                      << " x " << placement.xPos << " y " << placement.yPos
+                      << std::endl;
+        }
+    }
+
+    std::cout << "Searched " << searchState.nodesVisited << " nodes on "
+              << threadCount << " threads in " << searchTime.count() << " s"
+              << std::endl;
+    return 0;
+}
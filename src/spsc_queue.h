@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Wait-free single producer, single consumer ring buffer. push is only
+// called from one thread and pop from one other thread, neither blocks nor
+// allocates. When the queue is full push drops the item and returns false.
+template <typename T, size_t CAPACITY>
+class SpscQueue {
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0,
+                  "SpscQueue capacity must be a power of two");
+
+   public:
+    bool push(const T& item) {
+        size_t head = headIndex.load(std::memory_order_relaxed);
+        size_t tail = tailIndex.load(std::memory_order_acquire);
+        if (head - tail == CAPACITY) {
+            return false;
+        }
+
+        buffer[head & (CAPACITY - 1)] = item;
+        headIndex.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& item) {
+        size_t tail = tailIndex.load(std::memory_order_relaxed);
+        size_t head = headIndex.load(std::memory_order_acquire);
+        if (head == tail) {
+            return false;
+        }
+
+        item = buffer[tail & (CAPACITY - 1)];
+        tailIndex.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+   private:
+    // Keep producer and consumer indices on separate cache lines
+    alignas(64) std::atomic<size_t> headIndex{0};
+    alignas(64) std::atomic<size_t> tailIndex{0};
+    T buffer[CAPACITY];
+};
@@ -0,0 +1,185 @@
+#include "telemetry.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace {
+
+template <typename T>
+void writeColumn(std::FILE* file, const std::vector<T>& column) {
+    std::fwrite(column.data(), sizeof(T), column.size(), file);
+}
+
+template <typename T>
+bool readColumn(std::FILE* file, std::vector<T>& column, uint32_t count) {
+    column.resize(count);
+    return std::fread(column.data(), sizeof(T), count, file) == count;
+}
+
+}  // namespace
+
+void TelemetryColumns::clear() {
+    gameId.clear();
+    blockIndex.clear();
+    rotationIndex.clear();
+    xPos.clear();
+    yPos.clear();
+    framesToPlace.clear();
+    rowsCleared.clear();
+    stackHeight.clear();
+    scoreDelta.clear();
+}
+
+void TelemetryColumns::append(uint32_t streamGameId,
+                              const PlacementEvent& event) {
+    gameId.push_back(streamGameId);
+    blockIndex.push_back(event.blockIndex);
+    rotationIndex.push_back(event.rotationIndex);
+    xPos.push_back(event.xPos);
+    yPos.push_back(event.yPos);
+    framesToPlace.push_back(event.framesToPlace);
+    rowsCleared.push_back(event.rowsCleared);
+    stackHeight.push_back(event.stackHeight);
+    scoreDelta.push_back(event.scoreDelta);
+}
+
+TelemetryWriter::~TelemetryWriter() {
+    close();
+}
+
+bool TelemetryWriter::open(const std::string& fileName) {
+    file = std::fopen(fileName.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+
+    std::fwrite(TELEMETRY_MAGIC, 1, sizeof(TELEMETRY_MAGIC), file);
+    std::fwrite(&TELEMETRY_VERSION, sizeof(TELEMETRY_VERSION), 1, file);
+
+    running = true;
+    writerThread = std::thread(&TelemetryWriter::run, this);
+    return true;
+}
+
+void TelemetryWriter::addStream(TelemetryStream& stream) {
+    std::lock_guard<std::mutex> lock(streamsMutex);
+    streams.push_back(&stream);
+}
+
+void TelemetryWriter::releaseStream(TelemetryStream* stream) {
+    std::lock_guard<std::mutex> lock(streamsMutex);
+    releasedStreams.push_back(stream);
+}
+
+void TelemetryWriter::close() {
+    if (!file) {
+        return;
+    }
+
+    running = false;
+    writerThread.join();
+
+    drainStreams();
+    writeBlock();
+
+    std::fclose(file);
+    file = nullptr;
+}
+
+void TelemetryWriter::run() {
+    while (running) {
+        bool hasEvents = drainStreams();
+
+        // Nothing queued, give the games time to produce more
+        if (!hasEvents) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+}
+
+size_t TelemetryWriter::drainStream(TelemetryStream& stream) {
+    size_t eventCount = 0;
+    PlacementEvent event;
+    while (stream.events.pop(event)) {
+        columns.append(stream.gameId, event);
+        eventCount++;
+        if (columns.size() >= TELEMETRY_BLOCK_SIZE) {
+            writeBlock();
+        }
+    }
+    return eventCount;
+}
+
+bool TelemetryWriter::drainStreams() {
+    // Only the lists are copied under the lock, so addStream and
+    // releaseStream never wait for a drain or a block write. Streams are
+    // only deleted here, so the copied pointers stay valid.
+    {
+        std::lock_guard<std::mutex> lock(streamsMutex);
+        drainingStreams = streams;
+        finishedStreams.swap(releasedStreams);
+    }
+
+    size_t eventCount = 0;
+    for (TelemetryStream* stream : drainingStreams) {
+        eventCount += drainStream(*stream);
+    }
+
+    if (finishedStreams.empty()) {
+        return eventCount > 0;
+    }
+
+    // Released streams were pushed to before the release, so they are
+    // empty after the drain above
+    {
+        std::lock_guard<std::mutex> lock(streamsMutex);
+        for (TelemetryStream* stream : finishedStreams) {
+            streams.erase(std::remove(streams.begin(), streams.end(), stream),
+                          streams.end());
+        }
+    }
+    for (TelemetryStream* stream : finishedStreams) {
+        delete stream;
+    }
+    finishedStreams.clear();
+
+    return eventCount > 0;
+}
+
+void TelemetryWriter::writeBlock() {
+    if (!file || columns.size() == 0) {
+        return;
+    }
+
+    uint32_t eventCount = static_cast<uint32_t>(columns.size());
+    std::fwrite(&eventCount, sizeof(eventCount), 1, file);
+    writeColumn(file, columns.gameId);
+    writeColumn(file, columns.blockIndex);
+    writeColumn(file, columns.rotationIndex);
+    writeColumn(file, columns.xPos);
+    writeColumn(file, columns.yPos);
+    writeColumn(file, columns.framesToPlace);
+    writeColumn(file, columns.rowsCleared);
+    writeColumn(file, columns.stackHeight);
+    writeColumn(file, columns.scoreDelta);
+
+    columns.clear();
+}
+
+bool readTelemetryBlock(std::FILE* file, TelemetryColumns& columns) {
+    uint32_t eventCount;
+    if (std::fread(&eventCount, sizeof(eventCount), 1, file) != 1) {
+        return false;
+    }
+
+    return readColumn(file, columns.gameId, eventCount) &&
+           readColumn(file, columns.blockIndex, eventCount) &&
+           readColumn(file, columns.rotationIndex, eventCount) &&
+           readColumn(file, columns.xPos, eventCount) &&
+           readColumn(file, columns.yPos, eventCount) &&
+           readColumn(file, columns.framesToPlace, eventCount) &&
+           readColumn(file, columns.rowsCleared, eventCount) &&
+           readColumn(file, columns.stackHeight, eventCount) &&
+           readColumn(file, columns.scoreDelta, eventCount);
+}
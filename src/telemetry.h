@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "spsc_queue.h"
+
+// One locked block
+struct PlacementEvent {
+    uint8_t blockIndex;
+    uint8_t rotationIndex;
+    int8_t xPos;
+    int8_t yPos;
+    uint16_t framesToPlace;
+    uint8_t rowsCleared;
+    uint8_t stackHeight;
+    int32_t scoreDelta;
+};
+
+constexpr size_t TELEMETRY_QUEUE_SIZE = 4096;
+// Events written per block of the telemetry file
+constexpr size_t TELEMETRY_BLOCK_SIZE = 8192;
+
+constexpr char TELEMETRY_MAGIC[4] = {'T', 'T', 'E', 'L'};
+constexpr uint32_t TELEMETRY_VERSION = 1;
+
+// Placement events of one game. The game thread pushes, the writer thread
+// pops. Events are dropped and counted when the writer falls behind.
+struct TelemetryStream {
+    uint32_t gameId = 0;
+    SpscQueue<PlacementEvent, TELEMETRY_QUEUE_SIZE> events;
+    std::atomic<uint64_t> droppedEvents{0};
+};
+
+inline void recordPlacement(TelemetryStream& stream,
+                            const PlacementEvent& event) {
+    if (!stream.events.push(event)) {
+        stream.droppedEvents.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// Column buffers for one block of the file
+struct TelemetryColumns {
+    std::vector<uint32_t> gameId;
+    std::vector<uint8_t> blockIndex;
+    std::vector<uint8_t> rotationIndex;
+    std::vector<int8_t> xPos;
+    std::vector<int8_t> yPos;
+    std::vector<uint16_t> framesToPlace;
+    std::vector<uint8_t> rowsCleared;
+    std::vector<uint8_t> stackHeight;
+    std::vector<int32_t> scoreDelta;
+
+    size_t size() const { return gameId.size(); }
+    void clear();
+    void append(uint32_t streamGameId, const PlacementEvent& event);
+};
+
+// Background thread draining every registered stream into a columnar file.
+//
+// The file starts with TELEMETRY_MAGIC and TELEMETRY_VERSION, followed by
+// blocks of a uint32 event count and then each TelemetryColumns column as
+// a contiguous array, in declaration order and native byte order.
+class TelemetryWriter {
+   public:
+    ~TelemetryWriter();
+
+    bool open(const std::string& fileName);
+    // The stream has to outlive the writer unless it is released
+    void addStream(TelemetryStream& stream);
+    // Hands over a heap allocated stream nothing pushes to any more. The
+    // writer thread drains it and deletes it.
+    void releaseStream(TelemetryStream* stream);
+    // Drains every stream, writes what is left and closes the file
+    void close();
+
+   private:
+    void run();
+    size_t drainStream(TelemetryStream& stream);
+    bool drainStreams();
+    void writeBlock();
+
+    std::FILE* file = nullptr;
+    std::thread writerThread;
+    std::atomic<bool> running{false};
+
+    std::mutex streamsMutex;
+    std::vector<TelemetryStream*> streams;
+    std::vector<TelemetryStream*> releasedStreams;
+
+    // Only used by the writer thread
+    std::vector<TelemetryStream*> drainingStreams;
+    std::vector<TelemetryStream*> finishedStreams;
+    TelemetryColumns columns;
+};
+
+bool readTelemetryBlock(std::FILE* file, TelemetryColumns& columns);
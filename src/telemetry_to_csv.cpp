@@ -0,0 +1,57 @@
+// Converts a telemetry file written by TelemetryWriter to CSV on stdout.
+//
+// Usage: TelemetryToCsv FILE
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include "telemetry.h"
+
+const char BLOCK_NAMES[] = "IJLOSTZ";
+
+int main(int argc, char* argv[]) {
+    if (argc != 2) {
+        std::cerr << "Usage: TelemetryToCsv FILE" << std::endl;
+        return 1;
+    }
+
+    std::FILE* file = std::fopen(argv[1], "rb");
+    if (!file) {
+        std::cerr << "Failed to open " << argv[1] << std::endl;
+        return 1;
+    }
+
+    char magic[sizeof(TELEMETRY_MAGIC)];
+    uint32_t version;
+    if (std::fread(magic, 1, sizeof(magic), file) != sizeof(magic) ||
+        std::memcmp(magic, TELEMETRY_MAGIC, sizeof(magic)) != 0 ||
+        std::fread(&version, sizeof(version), 1, file) != 1 ||
+        version != TELEMETRY_VERSION) {
+        std::cerr << "Not a telemetry file: " << argv[1] << std::endl;
+        std::fclose(file);
+        return 1;
+    }
+
+    std::cout << "game,block,rotation,x,y,frames_to_place,rows_cleared,"
+                 "stack_height,score_delta\n";
+
+    TelemetryColumns columns;
+    while (readTelemetryBlock(file, columns)) {
+        for (size_t i = 0; i < columns.size(); i++) {
+            char blockName = columns.blockIndex[i] < 7
+                                 ? BLOCK_NAMES[columns.blockIndex[i]]
+                                 : '?';
+            std::cout << columns.gameId[i] << ',' << blockName << ','
+                      << int(columns.rotationIndex[i]) << ','
+                      << int(columns.xPos[i]) << ',' << int(columns.yPos[i])
+                      << ',' << columns.framesToPlace[i] << ','
+                      << int(columns.rowsCleared[i]) << ','
+                      << int(columns.stackHeight[i]) << ','
+                      << columns.scoreDelta[i] << '\n';
+        }
+    }
+
+    std::fclose(file);
+    return 0;
+}